@@ -28,6 +28,11 @@ import Foundation
 import Mte
 #endif
 
+// Imports for CPU feature queries.
+#if canImport(Darwin)
+import Darwin
+#endif
+
 // Interface of an entropy input callback.
 public protocol MteEntropyCallback {
   func entropyCallback(_ minEntropy: Int,
@@ -51,6 +56,11 @@ public protocol MteTimestampCallback {
   func timestampCallback() -> UInt64
 }
 
+// Interface of an object with a DRBG reseed counter.
+public protocol MteReseedCounter: AnyObject {
+  func getReseedCounter() -> UInt64
+}
+
 // Class MteBase
 //
 // This is the base for all MTE classes.
@@ -117,6 +127,19 @@ open class MteBase {
     return mte_wrap_base_has_runtime_opts() != MTE_FALSE
   }
 
+  // Returns true if the given CPU feature is reported present to MTE at
+  // initialization if it asks, or false if not. MTE only asks if it wasn't
+  // able to determine this itself; without the feature it falls back to
+  // slower portable code.
+  public class func getCpuFeature(_ info: mte_init_info) -> Bool {
+    switch info {
+    case mte_init_info_arm64_aes_paa:
+      return getSysctlFlag(["hw.optional.arm.FEAT_AES"], isAppleArm64())
+    default:
+      return false
+    }
+  }
+
   // Returns the default DRBG. If runtime options are not available, this is
   // the only option available; otherwise it is a suitable default.
   public class func getDefaultDrbg() -> mte_drbgs {
@@ -280,7 +303,7 @@ open class MteBase {
     // Initialize MTE.
     if !MteBase.ourMteInitialized {
       // Do global init.
-      if mte_init(nil, nil) == 0 {
+      if mte_init(MteBase.ourInitInfoCallback, nil) == 0 {
         throw MteError.logicError("MteBase.init: MTE init error.")
       }
       MteBase.ourMteInitialized = true
@@ -460,6 +483,26 @@ open class MteBase {
                               MteBase.getDrbgsNonceMaxBytes(drbg)))
   }
 
+  // Initialize with an external DRBG. The DRBG is reported as mte_drbgs_none
+  // and the nonce limits are taken from the given DRBG info.
+  public func initBase(_ drbgInfo: UnsafePointer<mte_drbg_info>,
+                       _ tokBytes: Int,
+                       _ verifiers: mte_verifiers,
+                       _ cipher: mte_ciphers,
+                       _ hash: mte_hashes) {
+    // Set the options.
+    myDrbg = mte_drbgs_none
+    myTokBytes = tokBytes
+    myVerifiers = verifiers
+    myCipher = cipher
+    myHash = hash
+
+    // Same as above, using the external DRBG's limits.
+    myNonceIntBytes = max(Int(drbgInfo.pointee.nonce_min_bytes),
+                          min(MemoryLayout<UInt64>.size,
+                              Int(drbgInfo.pointee.nonce_max_bytes)))
+  }
+
   // Helpers to resize arrays.
   public class func resizeArray(_ arr: inout [UInt8], _ newSize: Int) -> Void {
     if newSize > arr.count {
@@ -471,6 +514,115 @@ open class MteBase {
     resizeArray(&arr, Int(newSize))
   }
 
+  // Helper to copy segments one after another into an array, resizing it if
+  // necessary. Returns the total length of the segments in bytes.
+  public class func joinArray(_ arr: inout [UInt8],
+                              _ segments: [[UInt8]]) -> Int {
+    var bytes = 0
+    for s in segments {
+      bytes += s.count
+    }
+    resizeArray(&arr, bytes)
+    var off = 0
+    for s in segments {
+      arr.replaceSubrange(off..<off + s.count, with: s)
+      off += s.count
+    }
+    return bytes
+  }
+
+  // Helper to make a string from a Base64 encode. The encode is called with a
+  // buffer of the given size and returns the status and the offset and length
+  // of the result in the buffer. Where available, the buffer is the string's
+  // own storage so the result is written once; otherwise the given array is
+  // used and the string is made from the known length.
+  public class func encodeB64String(_ buffBytes: Int,
+                                    _ arr: inout [UInt8],
+                                    _ encode: (UnsafeMutableRawPointer?) ->
+                                      (mte_status, Int, Int)) ->
+  (encoded: String, status: mte_status) {
+    var status = mte_status_success
+    if #available(macOS 11.0, iOS 14.0, tvOS 14.0, watchOS 7.0, *) {
+      let b64 = String(unsafeUninitializedCapacity: buffBytes) { buff in
+        let (s, off, bytes) = encode(UnsafeMutableRawPointer(buff.baseAddress))
+        status = s
+        if status != mte_status_success {
+          return 0
+        }
+        if off != 0 {
+          UnsafeMutableRawPointer(buff.baseAddress!).copyMemory(
+            from: buff.baseAddress! + off, byteCount: bytes)
+        }
+        return bytes
+      }
+      return (b64, status)
+    }
+
+    // Use the array.
+    resizeArray(&arr, buffBytes)
+    let b64 = arr.withUnsafeMutableBytes { (buff) -> String in
+      let (s, off, bytes) = encode(buff.baseAddress)
+      status = s
+      if status != mte_status_success {
+        return String()
+      }
+      return String(decoding: UnsafeRawBufferPointer(rebasing:
+                                                       buff[off..<off + bytes]),
+                    as: UTF8.self)
+    }
+    return (b64, status)
+  }
+
+  // Helper to run a batch of encodes or decodes, packing the results one after
+  // another in an array, resizing it if necessary. The array is sized from the
+  // given buffer requirement of each item. A result ends within its own
+  // requirement, so packing the next one right after it always leaves room for
+  // the rest. An item with no buffer requirement is invalid input. Otherwise
+  // the code is called with the item's index and its place in the array and
+  // returns the status and the offset and length of the result there. On
+  // error, the item gets an empty result and the batch goes on, unless
+  // stopOnError is true, in which case only its status is added and the batch
+  // ends. Returns the packed length and each item's result offset, length, and
+  // status.
+  public class func packBatch(_ arr: inout [UInt8],
+                              _ buffBytes: [Int],
+                              _ stopOnError: Bool,
+                              _ code: (Int, UnsafeMutableRawPointer) ->
+                                (mte_status, Int, Int)) ->
+  (end: Int, offs: [Int], lens: [Int], statuses: [mte_status]) {
+    // Resize for the total requirement.
+    resizeArray(&arr, buffBytes.reduce(0, +))
+
+    // Run each item.
+    var offs = [Int]()
+    var lens = [Int]()
+    var statuses = [mte_status]()
+    offs.reserveCapacity(buffBytes.count)
+    lens.reserveCapacity(buffBytes.count)
+    statuses.reserveCapacity(buffBytes.count)
+    var end = 0
+    arr.withUnsafeMutableBytes { buff in
+      for i in 0..<buffBytes.count {
+        let (status, off, bytes) = buffBytes[i] == 0 ?
+          (mte_status_invalid_input, 0, 0) :
+          code(i, buff.baseAddress! + end)
+        statuses.append(status)
+        if statusIsError(status) {
+          if stopOnError {
+            break
+          }
+          offs.append(end)
+          lens.append(0)
+          continue
+        }
+        offs.append(end + off)
+        lens.append(bytes)
+        end += off + bytes
+      }
+    }
+    return (end, offs, lens, statuses)
+  }
+
   // Internal callbacks.
   public static let ourEntropyCallback: Optional<@convention(c)
     (UnsafeMutableRawPointer?,
@@ -530,6 +682,37 @@ open class MteBase {
       return c.timestampCallback()
     }
 
+  // Initialization information callback.
+  private static let ourInitInfoCallback: mte_init_info_cb = {
+    (context, info) -> Int32 in
+    return MteBase.getCpuFeature(info) ? 1 : 0
+  }
+
+  // Returns the first of the named sysctl flags found, or the default if none
+  // are found.
+  private class func getSysctlFlag(_ names: [String], _ dflt: Bool) -> Bool {
+#if canImport(Darwin)
+    for name in names {
+      var value: Int32 = 0
+      var size = MemoryLayout<Int32>.size
+      if sysctlbyname(name, &value, &size, nil, 0) == 0 {
+        return value != 0
+      }
+    }
+#endif
+    return dflt
+  }
+
+  // Returns true if running on an Apple ARM64 CPU, all of which have the AES
+  // extension.
+  private class func isAppleArm64() -> Bool {
+#if arch(arm64) && canImport(Darwin)
+    return true
+#else
+    return false
+#endif
+  }
+
   // Options.
   private var myDrbg = mte_drbgs_none
   private var myTokBytes = 0
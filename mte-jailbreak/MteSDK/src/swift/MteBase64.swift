@@ -0,0 +1,372 @@
+// The MIT License (MIT)
+//
+// Copyright (c) Eclypses, Inc.
+//
+// All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Class MteBase64
+//
+// This is a Base64 codec (RFC 4648) producing the same results as the one used
+// by the MTE _b64 functions. Use it to Base64 data outside of MTE, such as for
+// transport of MKE chunked output. The MTE _b64 functions do not use this
+// codec; they use the one in the MTE core library.
+//
+// To Base64 data chunk by chunk in constant memory, create an object of this
+// type, call startEncode(), call encodeChunk() zero or more times, then
+// finishEncode(). Decoding is the same with startDecode(), decodeChunk() and
+// finishDecode(). The result is the same as the class functions give for all
+// the chunks together.
+public class MteBase64 {
+  // Returns the encoded length in bytes for the given data length in bytes.
+  public class func encodeBytes(_ bytes: Int) -> Int {
+    return (bytes + 2) / 3 * 4
+  }
+
+  // Returns the maximum decoded length in bytes for the given Base64 length in
+  // bytes.
+  public class func decodeBytes(_ bytes: Int) -> Int {
+    return (bytes + 3) / 4 * 3
+  }
+
+  // Encode the given data to the given buffer, which must be at least
+  // encodeBytes() in length. The result is not null terminated. Returns the
+  // encoded length in bytes.
+  public class func encode(_ data: UnsafeRawBufferPointer,
+                           _ encoded: UnsafeMutableRawPointer) -> Int {
+    if data.count == 0 {
+      return 0
+    }
+    let inp = data.baseAddress!.assumingMemoryBound(to: UInt8.self)
+    let out = encoded.assumingMemoryBound(to: UInt8.self)
+    let whole = data.count / 3 * 3
+    var o = encodeGroups(inp, whole, out)
+    o += encodeTail(inp + whole, data.count - whole, out + o)
+    return o
+  }
+
+  // Encode the given data. Returns the encoded version.
+  public class func encode(_ data: [UInt8]) -> String {
+    let bytes = encodeBytes(data.count)
+    if #available(macOS 11.0, iOS 14.0, tvOS 14.0, watchOS 7.0, *) {
+      return String(unsafeUninitializedCapacity: bytes) { buff in
+        data.withUnsafeBytes { dbuff in
+          encode(dbuff, UnsafeMutableRawPointer(buff.baseAddress!))
+        }
+      }
+    }
+    var encoded = [UInt8](repeating: 0, count: bytes)
+    encoded.withUnsafeMutableBytes { buff in
+      data.withUnsafeBytes { dbuff in
+        _ = encode(dbuff, buff.baseAddress!)
+      }
+    }
+    return String(decoding: encoded, as: UTF8.self)
+  }
+
+  // Decode the given Base64 to the given buffer, which must be at least
+  // decodeBytes() in length and must not overlap the input. Invalid input
+  // bytes are ignored, and missing pad characters at the end are assumed if
+  // necessary. Returns the decoded length in bytes.
+  public class func decode(_ base64: UnsafeRawBufferPointer,
+                           _ decoded: UnsafeMutableRawPointer) -> Int {
+    if base64.count == 0 {
+      return 0
+    }
+    let inp = base64.baseAddress!.assumingMemoryBound(to: UInt8.self)
+    let out = decoded.assumingMemoryBound(to: UInt8.self)
+    var g = UInt32(0)
+    var n = 0
+    var o = decodeGroups(inp, base64.count, out, &g, &n)
+    o += decodeTail(g, n, out + o)
+    return o
+  }
+
+  // Decode the given Base64. Returns the decoded version.
+  public class func decode(_ base64: String) -> [UInt8] {
+    var str = base64
+    return str.withUTF8 { buff in
+      var decoded = [UInt8](repeating: 0, count: decodeBytes(buff.count))
+      let bytes = decoded.withUnsafeMutableBytes { dbuff in
+        decode(UnsafeRawBufferPointer(buff), dbuff.baseAddress!)
+      }
+      decoded.removeLast(decoded.count - bytes)
+      return decoded
+    }
+  }
+
+  // Initialize a streaming codec. Use the class functions instead if the whole
+  // input is available at once.
+  public init() {
+  }
+
+  // Returns the maximum encoded length in bytes of an encodeChunk() call with
+  // the given data length in bytes.
+  public func encodeChunkBytes(_ bytes: Int) -> Int {
+    return (myEncLeftBytes + bytes) / 3 * 4
+  }
+
+  // Start a streaming encode session.
+  public func startEncode() {
+    myEncLeftBytes = 0
+  }
+
+  // Encode a chunk of data in a streaming encode session to the given buffer,
+  // which must be at least encodeChunkBytes() in length. Up to 2 bytes are
+  // kept until the next chunk or finishEncode(). Returns the encoded length in
+  // bytes.
+  public func encodeChunk(_ data: UnsafeRawBufferPointer,
+                          _ encoded: UnsafeMutableRawPointer) -> Int {
+    if data.count == 0 {
+      return 0
+    }
+    var inp = data.baseAddress!.assumingMemoryBound(to: UInt8.self)
+    var count = data.count
+    let out = encoded.assumingMemoryBound(to: UInt8.self)
+    var o = 0
+
+    // Complete the leftover group first.
+    if myEncLeftBytes != 0 {
+      while myEncLeftBytes < 3 && count != 0 {
+        myEncLeft[myEncLeftBytes] = inp[0]
+        myEncLeftBytes += 1
+        inp += 1
+        count -= 1
+      }
+      if myEncLeftBytes < 3 {
+        return 0
+      }
+      o = myEncLeft.withUnsafeBufferPointer { buff in
+        MteBase64.encodeGroups(buff.baseAddress!, 3, out)
+      }
+      myEncLeftBytes = 0
+    }
+
+    // Encode the whole groups and keep the rest.
+    let whole = count / 3 * 3
+    o += MteBase64.encodeGroups(inp, whole, out + o)
+    for i in whole..<count {
+      myEncLeft[myEncLeftBytes] = inp[i]
+      myEncLeftBytes += 1
+    }
+    return o
+  }
+
+  // Encode a chunk of data in a streaming encode session. Returns the encoded
+  // version, which may be empty.
+  public func encodeChunk(_ data: [UInt8]) -> String {
+    var encoded = [UInt8](repeating: 0, count: encodeChunkBytes(data.count))
+    let bytes = encoded.withUnsafeMutableBytes { buff in
+      data.withUnsafeBytes { dbuff in
+        encodeChunk(dbuff, buff.baseAddress!)
+      }
+    }
+    return String(decoding: encoded[0..<bytes], as: UTF8.self)
+  }
+
+  // Finish a streaming encode session. Returns the final part of the encoded
+  // version, including padding.
+  public func finishEncode() -> String {
+    var encoded = [UInt8](repeating: 0, count: 4)
+    let bytes = encoded.withUnsafeMutableBufferPointer { buff in
+      myEncLeft.withUnsafeBufferPointer { lbuff in
+        MteBase64.encodeTail(lbuff.baseAddress!, myEncLeftBytes,
+                             buff.baseAddress!)
+      }
+    }
+    myEncLeftBytes = 0
+    return String(decoding: encoded[0..<bytes], as: UTF8.self)
+  }
+
+  // Returns the maximum decoded length in bytes of a decodeChunk() call with
+  // the given Base64 length in bytes.
+  public func decodeChunkBytes(_ bytes: Int) -> Int {
+    return (myDecLeftChars + bytes) / 4 * 3
+  }
+
+  // Start a streaming decode session.
+  public func startDecode() {
+    myDecLeft = 0
+    myDecLeftChars = 0
+  }
+
+  // Decode a chunk of Base64 in a streaming decode session to the given
+  // buffer, which must be at least decodeChunkBytes() in length and must not
+  // overlap the input. Up to 3 characters are kept until the next chunk or
+  // finishDecode(). Invalid input bytes are ignored. Returns the decoded
+  // length in bytes.
+  public func decodeChunk(_ base64: UnsafeRawBufferPointer,
+                          _ decoded: UnsafeMutableRawPointer) -> Int {
+    if base64.count == 0 {
+      return 0
+    }
+    let inp = base64.baseAddress!.assumingMemoryBound(to: UInt8.self)
+    let out = decoded.assumingMemoryBound(to: UInt8.self)
+    return MteBase64.decodeGroups(inp, base64.count, out,
+                                  &myDecLeft, &myDecLeftChars)
+  }
+
+  // Decode a chunk of Base64 in a streaming decode session. Returns the
+  // decoded version, which may be empty.
+  public func decodeChunk(_ base64: String) -> [UInt8] {
+    var str = base64
+    return str.withUTF8 { buff in
+      var decoded = [UInt8](repeating: 0,
+                            count: decodeChunkBytes(buff.count))
+      let bytes = decoded.withUnsafeMutableBytes { dbuff in
+        decodeChunk(UnsafeRawBufferPointer(buff), dbuff.baseAddress!)
+      }
+      decoded.removeLast(decoded.count - bytes)
+      return decoded
+    }
+  }
+
+  // Finish a streaming decode session. Returns the final part of the decoded
+  // version, assuming missing pad characters if necessary.
+  public func finishDecode() -> [UInt8] {
+    var decoded = [UInt8](repeating: 0, count: 2)
+    let bytes = decoded.withUnsafeMutableBufferPointer { buff in
+      MteBase64.decodeTail(myDecLeft, myDecLeftChars, buff.baseAddress!)
+    }
+    startDecode()
+    decoded.removeLast(decoded.count - bytes)
+    return decoded
+  }
+
+  // Encode the given number of bytes, which must be a multiple of 3, to the
+  // given buffer. Returns the encoded length in bytes.
+  private class func encodeGroups(_ inp: UnsafePointer<UInt8>,
+                                  _ count: Int,
+                                  _ out: UnsafeMutablePointer<UInt8>) -> Int {
+    var i = 0
+    var o = 0
+    while i < count {
+      let g = (UInt32(inp[i]) << 16) | (UInt32(inp[i + 1]) << 8) |
+              UInt32(inp[i + 2])
+      out[o] = ourEncTable[Int(g >> 18)]
+      out[o + 1] = ourEncTable[Int((g >> 12) & 63)]
+      out[o + 2] = ourEncTable[Int((g >> 6) & 63)]
+      out[o + 3] = ourEncTable[Int(g & 63)]
+      i += 3
+      o += 4
+    }
+    return o
+  }
+
+  // Encode the final 0-2 bytes with padding to the given buffer. Returns the
+  // encoded length in bytes.
+  private class func encodeTail(_ inp: UnsafePointer<UInt8>,
+                                _ count: Int,
+                                _ out: UnsafeMutablePointer<UInt8>) -> Int {
+    if count == 1 {
+      let g = UInt32(inp[0]) << 16
+      out[0] = ourEncTable[Int(g >> 18)]
+      out[1] = ourEncTable[Int((g >> 12) & 63)]
+      out[2] = ourPad
+      out[3] = ourPad
+      return 4
+    } else if count == 2 {
+      let g = (UInt32(inp[0]) << 16) | (UInt32(inp[1]) << 8)
+      out[0] = ourEncTable[Int(g >> 18)]
+      out[1] = ourEncTable[Int((g >> 12) & 63)]
+      out[2] = ourEncTable[Int((g >> 6) & 63)]
+      out[3] = ourPad
+      return 4
+    }
+    return 0
+  }
+
+  // Decode the given number of characters to the given buffer, continuing the
+  // given partial group of n 6-bit values in g and leaving the new partial
+  // group there. Returns the decoded length in bytes.
+  private class func decodeGroups(_ inp: UnsafePointer<UInt8>,
+                                  _ count: Int,
+                                  _ out: UnsafeMutablePointer<UInt8>,
+                                  _ g: inout UInt32,
+                                  _ n: inout Int) -> Int {
+    var o = 0
+    for i in 0..<count {
+      decodeChar(inp[i], out, &o, &g, &n)
+    }
+    return o
+  }
+
+  // Add one character to the partial group, skipping anything other than the
+  // 64 characters, and write three bytes when the group is complete.
+  @inline(__always)
+  private class func decodeChar(_ c: UInt8,
+                                _ out: UnsafeMutablePointer<UInt8>,
+                                _ o: inout Int,
+                                _ g: inout UInt32,
+                                _ n: inout Int) {
+    let v = ourDecTable[Int(c)]
+    if v == ourInvalid {
+      return
+    }
+    g = (g << 6) | UInt32(v)
+    n += 1
+    if n == 4 {
+      out[o] = UInt8(truncatingIfNeeded: g >> 16)
+      out[o + 1] = UInt8(truncatingIfNeeded: g >> 8)
+      out[o + 2] = UInt8(truncatingIfNeeded: g)
+      o += 3
+      g = 0
+      n = 0
+    }
+  }
+
+  // Decode the final partial group of n 6-bit values in g, assuming missing
+  // pad characters, to the given buffer. Returns the decoded length in bytes.
+  private class func decodeTail(_ g: UInt32, _ n: Int,
+                                _ out: UnsafeMutablePointer<UInt8>) -> Int {
+    if n == 2 {
+      out[0] = UInt8(truncatingIfNeeded: g >> 4)
+      return 1
+    } else if n == 3 {
+      out[0] = UInt8(truncatingIfNeeded: g >> 10)
+      out[1] = UInt8(truncatingIfNeeded: g >> 2)
+      return 2
+    }
+    return 0
+  }
+
+  // Encode and decode tables.
+  private static let ourEncTable: [UInt8] =
+    Array(("ABCDEFGHIJKLMNOPQRSTUVWXYZ" +
+           "abcdefghijklmnopqrstuvwxyz" +
+           "0123456789+/").utf8)
+  private static let ourPad = UInt8(ascii: "=")
+  private static let ourInvalid = UInt8(0xFF)
+  private static let ourDecTable: [UInt8] = {
+    var t = [UInt8](repeating: ourInvalid, count: 256)
+    for (i, c) in ourEncTable.enumerated() {
+      t[Int(c)] = UInt8(i)
+    }
+    return t
+  }()
+
+  // Streaming encode leftover bytes and their count.
+  private var myEncLeft = [UInt8](repeating: 0, count: 3)
+  private var myEncLeftBytes = 0
+
+  // Streaming decode partial group and its count of 6-bit values.
+  private var myDecLeft = UInt32(0)
+  private var myDecLeftChars = 0
+}
@@ -37,7 +37,7 @@ import Mte
 //
 // Alternatively, the state can be saved any time after instantiate() and
 // restored instead of instantiate() to pick up at a known point.
-public class MteDec : MteBase {
+public class MteDec : MteBase, MteReseedCounter {
   // Initialize using default options.
   //
   // The timestamp window and sequence window are optionally settable.
@@ -95,6 +95,83 @@ public class MteDec : MteBase {
                            count: Int(mte_wrap_dec_save_bytes_b64(myDecoder)))
   }
 
+  // Initialize taking an external DRBG state and info, token size in bytes,
+  // verifiers algorithm, timestamp window, and sequence window. The DRBG state
+  // and info must remain valid while the decoder is in use.
+  public init(_ drbgState: UnsafeMutableRawPointer,
+              _ drbgInfo: UnsafePointer<mte_drbg_info>,
+              _ tokBytes: Int,
+              _ verifiers: mte_verifiers,
+              _ tWindow: UInt64,
+              _ sWindow: Int) throws {
+    // Set up the init info.
+    var info = mte_dec_init_info()
+    info.dec_params.t_window = tWindow
+    info.dec_params.s_window = Int32(sWindow)
+    info.dec_params.drbg_state = drbgState
+    info.dec_params.drbg_info = drbgInfo
+    info.dec_params.drbg = mte_drbgs_none
+    info.dec_params.verifiers = verifiers
+    info.dec_params.tok_bytes = tokBytes
+
+    // Get the decoder size.
+    let bytes = Int(mte_dec_state_bytes(&info))
+    if bytes == 0 {
+      throw MteError.logicError("MteDec.init: Invalid options.")
+    }
+
+    // Allocate the decoder.
+    myDecoder =
+      UnsafeMutableRawPointer.allocate(byteCount: bytes,
+                                       alignment: MemoryLayout<Int64>.alignment)
+
+    // Super.
+    try super.init()
+
+    // Initialize the base.
+    super.initBase(drbgInfo,
+                   tokBytes,
+                   verifiers,
+                   mte_ciphers_none,
+                   mte_hashes_none)
+
+    // Initialize the decoder state.
+    let status = mte_dec_state_init(myDecoder, &info)
+    if status != mte_status_success {
+      throw MteError.logicError("MteDec.init: Invalid options.")
+    }
+
+    // Allocate the save buffers.
+    mySaveBuff = [UInt8](repeating: 0,
+                         count: Int(mte_wrap_dec_save_bytes(myDecoder)))
+    mySaveBuff64 = [UInt8](repeating: 0,
+                           count: Int(mte_wrap_dec_save_bytes_b64(myDecoder)))
+  }
+
+  // Initialize taking a prefetching DRBG, token size in bytes, verifiers
+  // algorithm, timestamp window, and sequence window. The decoder keeps a
+  // reference to the prefetching DRBG so it remains valid.
+  //
+  // This is plain prefetch, not a token cache: nothing is kept by sequence
+  // number. Every saved DRBG state includes the unused part of the ring, so in
+  // async sequencing mode (negative sequence window) each state the decoder
+  // keeps for its window grows by the ring size, and a reordered message
+  // regenerates its tokens from the wrapped DRBG once the saved ring bytes run
+  // out. Keep the ring small for async decoders.
+  public convenience init(_ drbg: MteDrbgPrefetch,
+                          _ tokBytes: Int,
+                          _ verifiers: mte_verifiers,
+                          _ tWindow: UInt64,
+                          _ sWindow: Int) throws {
+    try self.init(drbg.getDrbgState(),
+                  drbg.getDrbgInfo(),
+                  tokBytes,
+                  verifiers,
+                  tWindow,
+                  sWindow)
+    myPrefetch = drbg
+  }
+
   // Deallocate. The uninstantiate method is called.
   deinit {
     // Uninstantiate.
@@ -318,6 +395,81 @@ public class MteDec : MteBase {
     return (decOff + Int(dOff), Int(dBytes), status)
   }
 
+  // Decode each of the given encoded versions in order, exactly as if decode()
+  // were called on each one in turn. An error decoding one does not stop the
+  // rest from being decoded. The decoded versions are packed one after another
+  // in a single buffer. Returns the buffer and, for each encoded version, the
+  // offset and length in bytes of the decoded version in the buffer, the
+  // status, the encode/decode timestamps, and the messages skipped. The
+  // decoded version is valid only if !statusIsError(status); otherwise its
+  // length is 0. An encoded version with no decode buffer requirement is not
+  // decoded and gets mte_status_invalid_input.
+  public func decodeBatch(_ encoded: [[UInt8]]) ->
+  (decoded: ArraySlice<UInt8>, offs: [Int], lens: [Int],
+   statuses: [mte_status], encTs: [UInt64], decTs: [UInt64],
+   msgSkipped: [UInt32]) {
+    // Get the decode buffer requirements.
+    let buffBytes = encoded.map {
+      Int(mte_wrap_dec_buff_bytes(myDecoder, UInt32($0.count)))
+    }
+
+    // Decode.
+    var encTs = [UInt64](repeating: 0, count: encoded.count)
+    var decTs = [UInt64](repeating: 0, count: encoded.count)
+    var msgSkipped = [UInt32](repeating: 0, count: encoded.count)
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    let r = MteBase.packBatch(&myDecBuff, buffBytes, false) { i, buff in
+      var dOff: UInt32 = 0
+      var dBytes: UInt32 = 0
+      let status = mte_wrap_dec_decode(myDecoder,
+                                       MteBase.ourTimestampCallback, uc,
+                                       encoded[i], UInt32(encoded[i].count),
+                                       buff, &dOff, &dBytes,
+                                       &myEncTs, &myDecTs, &myMsgSkipped)
+      encTs[i] = myEncTs
+      decTs[i] = myDecTs
+      msgSkipped[i] = myMsgSkipped
+      return (status, Int(dOff), Int(dBytes))
+    }
+
+    // Return the decoded part and the per-message information.
+    return (myDecBuff[0..<r.end], r.offs, r.lens, r.statuses,
+            encTs, decTs, msgSkipped)
+  }
+  public func decodeBatchB64(_ encoded: [String]) ->
+  (decoded: ArraySlice<UInt8>, offs: [Int], lens: [Int],
+   statuses: [mte_status], encTs: [UInt64], decTs: [UInt64],
+   msgSkipped: [UInt32]) {
+    // Get the decode buffer requirements.
+    let buffBytes = encoded.map {
+      Int(mte_wrap_dec_buff_bytes_b64(myDecoder, UInt32($0.utf8.count)))
+    }
+
+    // Decode.
+    var encTs = [UInt64](repeating: 0, count: encoded.count)
+    var decTs = [UInt64](repeating: 0, count: encoded.count)
+    var msgSkipped = [UInt32](repeating: 0, count: encoded.count)
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    let r = MteBase.packBatch(&myDecBuff, buffBytes, false) { i, buff in
+      var dOff: UInt32 = 0
+      var dBytes: UInt32 = 0
+      let status =
+        mte_wrap_dec_decode_b64(myDecoder,
+                                MteBase.ourTimestampCallback, uc,
+                                encoded[i], UInt32(encoded[i].utf8.count),
+                                buff, &dOff, &dBytes,
+                                &myEncTs, &myDecTs, &myMsgSkipped)
+      encTs[i] = myEncTs
+      decTs[i] = myDecTs
+      msgSkipped[i] = myMsgSkipped
+      return (status, Int(dOff), Int(dBytes))
+    }
+
+    // Return the decoded part and the per-message information.
+    return (myDecBuff[0..<r.end], r.offs, r.lens, r.statuses,
+            encTs, decTs, msgSkipped)
+  }
+
   // Returns the timestamp set during encoding or 0 if there is no timestamp.
   public func getEncTs() -> UInt64 {
     return myEncTs
@@ -334,6 +486,15 @@ public class MteDec : MteBase {
     return myMsgSkipped
   }
 
+  // Fill the prefetching DRBG's ring, if this decoder was created with one.
+  // Call this when idle. Returns the status.
+  public func prefetch() -> mte_status {
+    if myPrefetch == nil {
+      return mte_status_success
+    }
+    return myPrefetch!.prefetch(myPrefetch!.getRingBytes())
+  }
+
   // Uninstantiate the decoder. It is no longer usable after this call. Returns
   // the MTE status.
   public func uninstantiate() -> mte_status {
@@ -343,6 +504,9 @@ public class MteDec : MteBase {
   // The decoder state.
   private let myDecoder: UnsafeMutableRawPointer
 
+  // The prefetching DRBG, if any.
+  private var myPrefetch: MteDrbgPrefetch? = nil
+
   // Decoder buffer.
   private var myDecBuff = [UInt8]()
 
@@ -0,0 +1,492 @@
+// The MIT License (MIT)
+//
+// Copyright (c) Eclypses, Inc.
+//
+// All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Imports when creating a Swift Package Manager package.
+#if MTE_SWIFT_PACKAGE_MANAGER
+import Mte
+#endif
+
+// Class MteDrbgChaCha20
+//
+// This is an external DRBG based on the ChaCha20 stream cipher, for CPUs
+// without the AES extension, where the CTR DRBGs fall back to table-based AES.
+// MteBase.getCpuFeature(mte_init_info_arm64_aes_paa) tells which to use.
+//
+// Each generate uses the 256-bit key to produce a ChaCha20 keystream (zero
+// nonce, counter from 0). The first 32 bytes replace the key and the rest is
+// the output, so earlier output cannot be recovered from the state. The
+// keystream is produced 4 blocks at a time, with each state word held in a
+// SIMD4<UInt32> that has one lane per block. Requests longer than 64 KiB are
+// done in 64 KiB pieces, each replacing the key. Instantiation derives the key
+// from the entropy input, nonce and personalization string with the SHA-256
+// Hash_df derivation function of NIST SP 800-90A.
+//
+// To use, create an object of this type and pass getDrbgState() and
+// getDrbgInfo() to the external DRBG initializer of MteEnc or MteDec, or pass
+// getDrbgInfo() and getGenerateMulti() to MteDrbgPrefetch. The encoder and
+// decoder must both use this DRBG.
+//
+// This object must remain valid while the encoder or decoder is in use.
+public class MteDrbgChaCha20 {
+  // Initialize.
+  public init() {
+    myState = UnsafeMutableRawPointer.allocate(
+      byteCount: MteDrbgChaCha20.ourStateBytes, alignment: 16)
+    myState.initializeMemory(as: UInt8.self,
+                             repeating: 0,
+                             count: MteDrbgChaCha20.ourStateBytes)
+  }
+
+  // Deallocate. The state is zeroized first.
+  deinit {
+    myState.initializeMemory(as: UInt8.self,
+                             repeating: 0,
+                             count: MteDrbgChaCha20.ourStateBytes)
+    myState.deallocate()
+  }
+
+  // Returns the DRBG state and info to pass to an external DRBG initializer.
+  public func getDrbgState() -> UnsafeMutableRawPointer { return myState }
+  public func getDrbgInfo() -> UnsafePointer<mte_drbg_info> {
+    return UnsafePointer(MteDrbgChaCha20.ourInfo)
+  }
+
+  // Returns the multi-request generate callback to pass to MteDrbgPrefetch.
+  public class func getGenerateMulti() -> MteDrbgGenerateMulti {
+    return ourGenerateMulti
+  }
+
+  // Returns the reseed interval, after which generate returns
+  // mte_status_drbg_seedlife_reached.
+  public class func getReseedInterval() -> UInt64 {
+    return ourReseedInterval
+  }
+
+  // Produce 4 ChaCha20 blocks (256 bytes) with the given key, zero nonce and
+  // given starting block counter to the given buffer.
+  private static func blocks(_ key: UnsafeRawPointer,
+                             _ counter: UInt32,
+                             _ out: UnsafeMutableRawPointer) {
+    // Set up the initial state, one block per lane.
+    let s0 = SIMD4<UInt32>(repeating: 0x61707865)
+    let s1 = SIMD4<UInt32>(repeating: 0x3320646e)
+    let s2 = SIMD4<UInt32>(repeating: 0x79622d32)
+    let s3 = SIMD4<UInt32>(repeating: 0x6b206574)
+    let k0 = keyWord(key, 0), k1 = keyWord(key, 1)
+    let k2 = keyWord(key, 2), k3 = keyWord(key, 3)
+    let k4 = keyWord(key, 4), k5 = keyWord(key, 5)
+    let k6 = keyWord(key, 6), k7 = keyWord(key, 7)
+    let c = SIMD4<UInt32>(repeating: counter) &+ SIMD4<UInt32>(0, 1, 2, 3)
+    var x0 = s0, x1 = s1, x2 = s2, x3 = s3
+    var x4 = k0, x5 = k1, x6 = k2, x7 = k3
+    var x8 = k4, x9 = k5, x10 = k6, x11 = k7
+    var x12 = c
+    var x13 = SIMD4<UInt32>(), x14 = SIMD4<UInt32>(), x15 = SIMD4<UInt32>()
+
+    // Do the 20 rounds.
+    for _ in 0..<10 {
+      quarterRound(&x0, &x4, &x8, &x12)
+      quarterRound(&x1, &x5, &x9, &x13)
+      quarterRound(&x2, &x6, &x10, &x14)
+      quarterRound(&x3, &x7, &x11, &x15)
+      quarterRound(&x0, &x5, &x10, &x15)
+      quarterRound(&x1, &x6, &x11, &x12)
+      quarterRound(&x2, &x7, &x8, &x13)
+      quarterRound(&x3, &x4, &x9, &x14)
+    }
+
+    // Add the initial state and write each lane as a block.
+    storeWord(x0 &+ s0, 0, out)
+    storeWord(x1 &+ s1, 1, out)
+    storeWord(x2 &+ s2, 2, out)
+    storeWord(x3 &+ s3, 3, out)
+    storeWord(x4 &+ k0, 4, out)
+    storeWord(x5 &+ k1, 5, out)
+    storeWord(x6 &+ k2, 6, out)
+    storeWord(x7 &+ k3, 7, out)
+    storeWord(x8 &+ k4, 8, out)
+    storeWord(x9 &+ k5, 9, out)
+    storeWord(x10 &+ k6, 10, out)
+    storeWord(x11 &+ k7, 11, out)
+    storeWord(x12 &+ c, 12, out)
+    storeWord(x13, 13, out)
+    storeWord(x14, 14, out)
+    storeWord(x15, 15, out)
+  }
+
+  // Load the given 32-bit word of the key into every lane.
+  @inline(__always)
+  private static func keyWord(_ key: UnsafeRawPointer,
+                              _ i: Int) -> SIMD4<UInt32> {
+    return SIMD4<UInt32>(repeating: UInt32(littleEndian:
+      key.load(fromByteOffset: 4 * i, as: UInt32.self)))
+  }
+
+  // Store the given word of each lane's block.
+  @inline(__always)
+  private static func storeWord(_ v: SIMD4<UInt32>,
+                                _ i: Int,
+                                _ out: UnsafeMutableRawPointer) {
+    for lane in 0..<4 {
+      out.storeBytes(of: v[lane].littleEndian,
+                     toByteOffset: 64 * lane + 4 * i,
+                     as: UInt32.self)
+    }
+  }
+
+  // The ChaCha20 quarter round on 4 blocks at once.
+  @inline(__always)
+  private static func quarterRound(_ a: inout SIMD4<UInt32>,
+                                   _ b: inout SIMD4<UInt32>,
+                                   _ c: inout SIMD4<UInt32>,
+                                   _ d: inout SIMD4<UInt32>) {
+    a &+= b; d = rotate(d ^ a, 16)
+    c &+= d; b = rotate(b ^ c, 12)
+    a &+= b; d = rotate(d ^ a, 8)
+    c &+= d; b = rotate(b ^ c, 7)
+  }
+  @inline(__always)
+  private static func rotate(_ v: SIMD4<UInt32>,
+                             _ n: UInt32) -> SIMD4<UInt32> {
+    return (v &<< n) | (v &>> (32 - n))
+  }
+
+  // Generate the given number of bytes to the given buffer, replacing the key
+  // in the state. Requests longer than the maximum are done in pieces of the
+  // maximum, each replacing the key. Returns the status.
+  private static func generate(_ s: UnsafeMutableRawPointer,
+                               _ bytes: Int,
+                               _ out: UnsafeMutableRawPointer) -> mte_status {
+    // Check the seed life.
+    let counter = s.load(fromByteOffset: ourCounterOff, as: UInt64.self)
+    if counter == 0 {
+      return mte_status_drbg_error
+    }
+    if counter > ourReseedInterval {
+      return mte_status_drbg_seedlife_reached
+    }
+
+    // Generate the pieces.
+    var done = 0
+    repeat {
+      let n = min(bytes - done, ourMaxRequestBytes)
+      generatePiece(s, n, out + done)
+      done += n
+    } while done < bytes
+
+    // Increment the reseed counter.
+    s.storeBytes(of: counter + 1, toByteOffset: ourCounterOff, as: UInt64.self)
+    return mte_status_success
+  }
+
+  // Generate the given number of bytes, at most the maximum request, to the
+  // given buffer and replace the key. The keystream is produced 4 blocks at a
+  // time in the state's scratch area; the first 32 bytes are the new key.
+  private static func generatePiece(_ s: UnsafeMutableRawPointer,
+                                    _ bytes: Int,
+                                    _ out: UnsafeMutableRawPointer) {
+    let k = s + ourScratchOff
+    var blockCounter = UInt32(0)
+    var skip = 32
+    var done = 0
+    while done < bytes || blockCounter == 0 {
+      blocks(s + ourKeyOff, blockCounter, k)
+      blockCounter += 4
+      if skip != 0 {
+        (s + ourNewKeyOff).copyMemory(from: k, byteCount: 32)
+      }
+      let n = min(256 - skip, bytes - done)
+      (out + done).copyMemory(from: k + skip, byteCount: n)
+      done += n
+      skip = 0
+    }
+
+    // Replace the key and zeroize the new key and scratch area.
+    (s + ourKeyOff).copyMemory(from: s + ourNewKeyOff, byteCount: 32)
+    (s + ourNewKeyOff).initializeMemory(as: UInt8.self,
+                                        repeating: 0,
+                                        count: ourStateBytes - ourNewKeyOff)
+  }
+
+  // Derive the key from the given inputs with the SHA-256 Hash_df of NIST SP
+  // 800-90A section 10.3.1, as the Hash_DRBG derives its seed from the seed
+  // material. For a 256-bit key this is one hash:
+  //   key = SHA-256(0x01 || 256 as a 32-bit big-endian integer || inputs)
+  private static func deriveKey(_ s: UnsafeMutableRawPointer,
+                                _ inputs: [UnsafeRawBufferPointer]) {
+    // Gather the counter, bit count and inputs, followed by the SHA-256
+    // padding, in one buffer.
+    var bytes = 5
+    for input in inputs {
+      bytes += input.count
+    }
+    var m = [UInt8](repeating: 0, count: (bytes + 9 + 63) / 64 * 64)
+    m.withUnsafeMutableBytes { mbuff in
+      let p = mbuff.baseAddress!
+      p.storeBytes(of: 1, toByteOffset: 0, as: UInt8.self)
+      p.storeBytes(of: 1, toByteOffset: 3, as: UInt8.self)
+      var off = 5
+      for input in inputs where input.count != 0 {
+        (p + off).copyMemory(from: input.baseAddress!, byteCount: input.count)
+        off += input.count
+      }
+      p.storeBytes(of: 0x80, toByteOffset: off, as: UInt8.self)
+      for i in 0..<8 {
+        p.storeBytes(of: UInt8(truncatingIfNeeded: (8 * bytes) >> (56 - 8 * i)),
+                     toByteOffset: mbuff.count - 8 + i,
+                     as: UInt8.self)
+      }
+      sha256(UnsafeRawBufferPointer(mbuff), s + ourKeyOff)
+    }
+    m.resetBytes(in: 0..<m.count)
+  }
+
+  // Compute SHA-256 (FIPS 180-4) of the given already-padded message to the
+  // given 32-byte buffer.
+  private static func sha256(_ m: UnsafeRawBufferPointer,
+                             _ out: UnsafeMutableRawPointer) {
+    var h = ourSha256Iv
+    var w = [UInt32](repeating: 0, count: 64)
+    for block in stride(from: 0, to: m.count, by: 64) {
+      // Expand the message schedule.
+      for i in 0..<16 {
+        let b = block + 4 * i
+        w[i] = (UInt32(m[b]) << 24) | (UInt32(m[b + 1]) << 16) |
+               (UInt32(m[b + 2]) << 8) | UInt32(m[b + 3])
+      }
+      for i in 16..<64 {
+        let s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3)
+        let s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10)
+        w[i] = w[i - 16] &+ s0 &+ w[i - 7] &+ s1
+      }
+
+      // Do the 64 rounds and add to the hash value.
+      var a = h[0], b = h[1], c = h[2], d = h[3]
+      var e = h[4], f = h[5], g = h[6], hh = h[7]
+      for i in 0..<64 {
+        let s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)
+        let ch = (e & f) ^ (~e & g)
+        let t1 = hh &+ s1 &+ ch &+ ourSha256K[i] &+ w[i]
+        let s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)
+        let maj = (a & b) ^ (a & c) ^ (b & c)
+        hh = g
+        g = f
+        f = e
+        e = d &+ t1
+        d = c
+        c = b
+        b = a
+        a = t1 &+ s0 &+ maj
+      }
+      h[0] = h[0] &+ a
+      h[1] = h[1] &+ b
+      h[2] = h[2] &+ c
+      h[3] = h[3] &+ d
+      h[4] = h[4] &+ e
+      h[5] = h[5] &+ f
+      h[6] = h[6] &+ g
+      h[7] = h[7] &+ hh
+    }
+
+    // Write the hash value big-endian and zeroize the work.
+    for i in 0..<8 {
+      out.storeBytes(of: h[i].bigEndian, toByteOffset: 4 * i, as: UInt32.self)
+    }
+    h.withUnsafeMutableBytes { $0.initializeMemory(as: UInt8.self,
+                                                   repeating: 0) }
+    w.withUnsafeMutableBytes { $0.initializeMemory(as: UInt8.self,
+                                                   repeating: 0) }
+  }
+  @inline(__always)
+  private static func rotr(_ x: UInt32, _ n: UInt32) -> UInt32 {
+    return (x >> n) | (x << (32 - n))
+  }
+
+  // DRBG callbacks.
+  private static let ourInstantiate: mte_drbg_instantiate = {
+    (state, info) -> mte_status in
+    let s = state!
+    let inst = info!.pointee
+
+    // Get the entropy input.
+    var ei = [UInt8](repeating: 0, count: ourEntropyMinBytes)
+    var eiInfo = mte_drbg_ei_info()
+    eiInfo.min_entropy = .init(ourSecStrengthBytes)
+    eiInfo.min_length = .init(ourEntropyMinBytes)
+    eiInfo.max_length = .init(ourEntropyMaxBytes)
+    eiInfo.bytes = .init(ei.count)
+    var nonce = [UInt8](repeating: 0, count: ourNonceMaxBytes)
+    var nInfo = mte_drbg_nonce_info()
+    nInfo.min_length = .init(ourNonceMinBytes)
+    nInfo.max_length = .init(ourNonceMaxBytes)
+    let status = ei.withUnsafeMutableBufferPointer { ebuff -> mte_status in
+      eiInfo.buff = ebuff.baseAddress
+      let status = inst.ei_cb!(inst.ei_cb_context, &eiInfo)
+      if status != mte_status_success {
+        return status
+      }
+      if Int(eiInfo.bytes) < ourEntropyMinBytes ||
+         Int(eiInfo.bytes) > ourEntropyMaxBytes {
+        return mte_status_drbg_catastrophic
+      }
+
+      // Get the nonce.
+      return nonce.withUnsafeMutableBufferPointer { nbuff -> mte_status in
+        nInfo.buff = nbuff.baseAddress
+        inst.n_cb!(inst.n_cb_context, &nInfo)
+
+        // Derive the key and reset the reseed counter.
+        deriveKey(s, [
+          UnsafeRawBufferPointer(start: eiInfo.buff,
+                                 count: Int(eiInfo.bytes)),
+          UnsafeRawBufferPointer(start: nbuff.baseAddress,
+                                 count: Int(nInfo.bytes)),
+          UnsafeRawBufferPointer(start: inst.ps, count: Int(inst.ps_bytes))
+        ])
+        s.storeBytes(of: UInt64(1),
+                     toByteOffset: ourCounterOff,
+                     as: UInt64.self)
+        return mte_status_success
+      }
+    }
+
+    // Zeroize the inputs we own.
+    ei.resetBytes(in: 0..<ei.count)
+    nonce.resetBytes(in: 0..<nonce.count)
+    return status
+  }
+  private static let ourReseedCounter: mte_drbg_reseed_counter = {
+    (state) -> UInt64 in
+    return state!.load(fromByteOffset: ourCounterOff, as: UInt64.self)
+  }
+  private static let ourStateSave: mte_drbg_state_save = {
+    (state, saved) in
+    saved!.copyMemory(from: state!, byteCount: ourSaveBytes)
+  }
+  private static let ourStateRestore: mte_drbg_state_restore = {
+    (state, saved) in
+    state!.copyMemory(from: saved!, byteCount: ourSaveBytes)
+  }
+  private static let ourGenerate: mte_drbg_generate = {
+    (state, bytes, randomNumber) -> mte_status in
+    return generate(state!, bytes, randomNumber!)
+  }
+  private static let ourGenerateMulti: MteDrbgGenerateMulti = {
+    (state, requests, count) -> mte_status in
+    // Check the seed life for all requests first, so an error generates none.
+    let s = state!
+    let counter = s.load(fromByteOffset: ourCounterOff, as: UInt64.self)
+    if counter == 0 {
+      return mte_status_drbg_error
+    }
+    if counter + UInt64(count) - 1 > ourReseedInterval {
+      return mte_status_drbg_seedlife_reached
+    }
+    for i in 0..<count {
+      let r = requests![i]
+      let status = generate(s, r.bytes, r.buffer!)
+      if status != mte_status_success {
+        return status
+      }
+    }
+    return mte_status_success
+  }
+  private static let ourUninstantiate: mte_drbg_uninstantiate = {
+    (state) -> mte_status in
+    state!.initializeMemory(as: UInt8.self, repeating: 0, count: ourStateBytes)
+    return mte_status_success
+  }
+
+  // The DRBG info, shared by all objects of this type.
+  private static let ourInfo: UnsafeMutablePointer<mte_drbg_info> = {
+    let info = UnsafeMutablePointer<mte_drbg_info>.allocate(capacity: 1)
+    info.initialize(to: mte_drbg_info())
+    info.pointee.state_bytes = .init(ourStateBytes)
+    info.pointee.save_bytes = .init(ourSaveBytes)
+    info.pointee.sec_strength_bytes = .init(ourSecStrengthBytes)
+    info.pointee.personal_min_bytes = 0
+    info.pointee.personal_max_bytes = .init(ourPersonalMaxBytes)
+    info.pointee.entropy_min_bytes = .init(ourEntropyMinBytes)
+    info.pointee.entropy_max_bytes = .init(ourEntropyMaxBytes)
+    info.pointee.nonce_min_bytes = .init(ourNonceMinBytes)
+    info.pointee.nonce_max_bytes = .init(ourNonceMaxBytes)
+    info.pointee.reseed_interval = ourReseedInterval
+    info.pointee.instantiate = ourInstantiate
+    info.pointee.reseed_counter = ourReseedCounter
+    info.pointee.state_save = ourStateSave
+    info.pointee.state_restore = ourStateRestore
+    info.pointee.generate = ourGenerate
+    info.pointee.uninstantiate = ourUninstantiate
+    return info
+  }()
+
+  // Limits. The reseed interval matches that of the CTR DRBGs. Longer
+  // requests are done in pieces of the maximum request, each replacing the
+  // key.
+  private static let ourSecStrengthBytes = 32
+  private static let ourPersonalMaxBytes = 256
+  private static let ourEntropyMinBytes = 32
+  private static let ourEntropyMaxBytes = 256
+  private static let ourNonceMinBytes = 0
+  private static let ourNonceMaxBytes = 32
+  private static let ourReseedInterval = UInt64(1) << 48
+  private static let ourMaxRequestBytes = 1 << 16
+
+  // State layout. The key and reseed counter are saved. The new key and
+  // keystream scratch area are used only during a generate call and are
+  // zeroized after it.
+  private static let ourKeyOff = 0
+  private static let ourCounterOff = 32
+  private static let ourSaveBytes = 40
+  private static let ourNewKeyOff = 48
+  private static let ourScratchOff = 80
+  private static let ourStateBytes = 336
+
+  // SHA-256 initial hash value and round constants.
+  private static let ourSha256Iv: [UInt32] = [
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  ]
+  private static let ourSha256K: [UInt32] = [
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+  ]
+
+  // The state.
+  private let myState: UnsafeMutableRawPointer
+}
@@ -0,0 +1,372 @@
+// The MIT License (MIT)
+//
+// Copyright (c) Eclypses, Inc.
+//
+// All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Imports when creating a Swift Package Manager package.
+#if MTE_SWIFT_PACKAGE_MANAGER
+import Mte
+#endif
+
+// Multi-request generate callback of a wrapped DRBG. It must fill each of the
+// given number of requests in order, giving the same output as a generate call
+// for each. On error, no request is considered filled and the DRBG state must
+// be as it was before the call.
+public typealias MteDrbgGenerateMulti =
+  @convention(c) (UnsafeMutableRawPointer?,
+                  UnsafePointer<mte_verifier_drbg_gen>?,
+                  Int) -> mte_status
+
+// Class MteDrbgPrefetch
+//
+// This is an external DRBG that wraps another external DRBG and prefetches its
+// output into a ring, so the DRBG work can be done ahead of time instead of
+// during encode.
+//
+// To use, create an object of this type with the info of the DRBG to wrap and
+// pass getDrbgState() and getDrbgInfo() to the external DRBG initializer of
+// MteEnc or MteDec. Then call prefetch() when idle to fill the ring.
+//
+// The wrapped DRBG is always asked for the block size at a time, so the random
+// stream does not depend on when or whether prefetch() is called. The encoder
+// and decoder must use the same wrapped DRBG and block size. The reseed counter
+// leaves out blocks still unused in the ring, so it too does not depend on
+// prefetching and both sides reach the seed life at the same point.
+//
+// Each saved state holds the unused part of the ring, so the save size grows
+// by the ring size. A decoder in async sequencing mode keeps saved states for
+// its window, so size the ring with that in mind.
+//
+// If the wrapped DRBG also has a multi-request generate callback, prefetch()
+// asks it for all the blocks it needs in one call, so a hardware-backed or
+// vectorized DRBG can spread its setup across them.
+//
+// This object must remain valid while the encoder or decoder is in use. The
+// prefetch() method must not be called while encoding or decoding.
+public class MteDrbgPrefetch {
+  // Initialize taking the info of the DRBG to wrap, the block size in bytes to
+  // generate from it at a time, the ring size in bytes, and optionally the
+  // multi-request generate callback of the DRBG to wrap. The ring size is
+  // rounded up to a multiple of the block size.
+  public init(_ drbgInfo: UnsafePointer<mte_drbg_info>,
+              _ blockBytes: Int = 256,
+              _ ringBytes: Int = 4096,
+              _ generateMulti: MteDrbgGenerateMulti? = nil) throws {
+    let inner = drbgInfo.pointee
+    if blockBytes <= 0 || ringBytes <= 0 ||
+       inner.instantiate == nil || inner.reseed_counter == nil ||
+       inner.state_save == nil || inner.state_restore == nil ||
+       inner.generate == nil || inner.uninstantiate == nil {
+      throw MteError.logicError("MteDrbgPrefetch.init: Invalid options.")
+    }
+
+    // Determine the state layout.
+    let ring = (ringBytes + blockBytes - 1) / blockBytes * blockBytes
+    let innerBytes = (Int(drbgInfo.pointee.state_bytes) + 15) & ~15
+    let ringOff = MteDrbgPrefetch.ourInnerOff + innerBytes
+    let stateBytes = ringOff + ring
+
+    // Allocate the state and set up the header.
+    myState = UnsafeMutableRawPointer.allocate(byteCount: stateBytes,
+                                               alignment: 16)
+    myState.initializeMemory(as: UInt8.self, repeating: 0, count: stateBytes)
+    myState.storeBytes(of: UnsafeRawPointer(drbgInfo),
+                       toByteOffset: MteDrbgPrefetch.ourInfoOff,
+                       as: UnsafeRawPointer.self)
+    myState.storeBytes(of: blockBytes,
+                       toByteOffset: MteDrbgPrefetch.ourBlockOff,
+                       as: Int.self)
+    myState.storeBytes(of: ring,
+                       toByteOffset: MteDrbgPrefetch.ourRingBytesOff,
+                       as: Int.self)
+    myState.storeBytes(of: ringOff,
+                       toByteOffset: MteDrbgPrefetch.ourRingOff,
+                       as: Int.self)
+
+    // Set up the info. The limits are those of the wrapped DRBG.
+    myInfo = UnsafeMutablePointer<mte_drbg_info>.allocate(capacity: 1)
+    myInfo.initialize(to: drbgInfo.pointee)
+    myInfo.pointee.state_bytes = stateBytes
+    myInfo.pointee.save_bytes =
+      MteDrbgPrefetch.ourSaveHdrBytes + ring + drbgInfo.pointee.save_bytes
+    myInfo.pointee.instantiate = MteDrbgPrefetch.ourInstantiate
+    myInfo.pointee.reseed_counter = MteDrbgPrefetch.ourReseedCounter
+    myInfo.pointee.state_save = MteDrbgPrefetch.ourStateSave
+    myInfo.pointee.state_restore = MteDrbgPrefetch.ourStateRestore
+    myInfo.pointee.generate = MteDrbgPrefetch.ourGenerate
+    myInfo.pointee.uninstantiate = MteDrbgPrefetch.ourUninstantiate
+    myGenerateMulti = generateMulti
+  }
+
+  // Deallocate. The state is zeroized first.
+  deinit {
+    myState.initializeMemory(as: UInt8.self,
+                             repeating: 0,
+                             count: myInfo.pointee.state_bytes)
+    myState.deallocate()
+    myInfo.deallocate()
+  }
+
+  // Returns the DRBG state and info to pass to an external DRBG initializer.
+  public func getDrbgState() -> UnsafeMutableRawPointer { return myState }
+  public func getDrbgInfo() -> UnsafePointer<mte_drbg_info> {
+    return UnsafePointer(myInfo)
+  }
+
+  // Returns the ring size in bytes.
+  public func getRingBytes() -> Int {
+    return MteDrbgPrefetch.loadInt(myState, MteDrbgPrefetch.ourRingBytesOff)
+  }
+
+  // Returns the number of prefetched bytes not yet used.
+  public func getAvailBytes() -> Int {
+    return MteDrbgPrefetch.loadInt(myState, MteDrbgPrefetch.ourAvailOff)
+  }
+
+  // Prefetch until at least the given number of bytes are available or the ring
+  // is full. The DRBG must be instantiated. Returns the status; an error from
+  // the wrapped DRBG, such as reaching its seed life, stops the prefetch and is
+  // returned again once the prefetched bytes are used.
+  public func prefetch(_ bytes: Int) -> mte_status {
+    let s = myState
+    let block = MteDrbgPrefetch.loadInt(s, MteDrbgPrefetch.ourBlockOff)
+    let ring = MteDrbgPrefetch.loadInt(s, MteDrbgPrefetch.ourRingBytesOff)
+    if let multi = myGenerateMulti {
+      return prefetchMulti(multi, bytes, block, ring)
+    }
+    while true {
+      let avail = MteDrbgPrefetch.loadInt(s, MteDrbgPrefetch.ourAvailOff)
+      if avail >= bytes || avail + block > ring {
+        return mte_status_success
+      }
+      let status = MteDrbgPrefetch.fillBlock(s)
+      if status != mte_status_success {
+        return status
+      }
+    }
+  }
+
+  // Prefetch with one multi-request generate call for all the blocks needed.
+  // Returns the status.
+  private func prefetchMulti(_ multi: MteDrbgGenerateMulti,
+                             _ bytes: Int,
+                             _ block: Int,
+                             _ ring: Int) -> mte_status {
+    // Determine the number of blocks.
+    let s = myState
+    let avail = MteDrbgPrefetch.loadInt(s, MteDrbgPrefetch.ourAvailOff)
+    let want = (min(bytes, ring) - avail + block - 1) / block
+    let blocks = min(want, (ring - avail) / block)
+    if blocks <= 0 {
+      return mte_status_success
+    }
+
+    // Set up a request per block. The write position is always a multiple of
+    // the block size, so no block wraps.
+    let ringBuff = s + MteDrbgPrefetch.loadInt(s, MteDrbgPrefetch.ourRingOff)
+    var write = (MteDrbgPrefetch.loadInt(s, MteDrbgPrefetch.ourReadOff) +
+                 avail) % ring
+    myRequests.removeAll(keepingCapacity: true)
+    for _ in 0..<blocks {
+      myRequests.append(mte_verifier_drbg_gen(bytes: block,
+                                              buffer: ringBuff + write))
+      write = (write + block) % ring
+    }
+
+    // Generate them all.
+    let inner = s + MteDrbgPrefetch.ourInnerOff
+    let status = myRequests.withUnsafeBufferPointer { buff in
+      multi(inner, buff.baseAddress, blocks)
+    }
+    if status == mte_status_success {
+      MteDrbgPrefetch.storeInt(s, MteDrbgPrefetch.ourAvailOff,
+                               avail + blocks * block)
+    }
+    return status
+  }
+
+  // Helpers to access the state header.
+  private static func loadInt(_ s: UnsafeRawPointer, _ off: Int) -> Int {
+    return s.load(fromByteOffset: off, as: Int.self)
+  }
+  private static func storeInt(_ s: UnsafeMutableRawPointer,
+                               _ off: Int,
+                               _ value: Int) {
+    s.storeBytes(of: value, toByteOffset: off, as: Int.self)
+  }
+  private static func innerInfo(_ s: UnsafeRawPointer) ->
+  UnsafePointer<mte_drbg_info> {
+    return s.load(fromByteOffset: ourInfoOff, as: UnsafeRawPointer.self)
+      .assumingMemoryBound(to: mte_drbg_info.self)
+  }
+
+  // Helpers to save and restore a header value as a 64-bit integer. The saved
+  // state buffer may not be aligned.
+  private static func saveInt(_ saved: UnsafeMutableRawPointer,
+                              _ off: Int,
+                              _ value: Int) {
+    var v = UInt64(value)
+    (saved + off).copyMemory(from: &v, byteCount: 8)
+  }
+  private static func restoreInt(_ saved: UnsafeRawPointer,
+                                 _ off: Int) -> Int {
+    var v = UInt64(0)
+    withUnsafeMutableBytes(of: &v) { buff in
+      buff.baseAddress!.copyMemory(from: saved + off, byteCount: 8)
+    }
+    return Int(v)
+  }
+
+  // Reset the ring to empty, zeroizing it.
+  private static func resetRing(_ s: UnsafeMutableRawPointer) {
+    let ring = loadInt(s, ourRingBytesOff)
+    (s + loadInt(s, ourRingOff)).initializeMemory(as: UInt8.self,
+                                                  repeating: 0,
+                                                  count: ring)
+    storeInt(s, ourReadOff, 0)
+    storeInt(s, ourAvailOff, 0)
+  }
+
+  // Generate one block from the wrapped DRBG into the ring. The write position
+  // is always a multiple of the block size, so the block never wraps. Returns
+  // the status.
+  private static func fillBlock(_ s: UnsafeMutableRawPointer) -> mte_status {
+    let block = loadInt(s, ourBlockOff)
+    let ring = loadInt(s, ourRingBytesOff)
+    let avail = loadInt(s, ourAvailOff)
+    let write = (loadInt(s, ourReadOff) + avail) % ring
+    let buff = s + loadInt(s, ourRingOff) + write
+    let status = innerInfo(s).pointee.generate!(s + ourInnerOff, block, buff)
+    if status == mte_status_success {
+      storeInt(s, ourAvailOff, avail + block)
+    }
+    return status
+  }
+
+  // DRBG callbacks.
+  private static let ourInstantiate: mte_drbg_instantiate = {
+    (state, info) -> mte_status in
+    let s = state!
+    resetRing(s)
+    return innerInfo(s).pointee.instantiate!(s + ourInnerOff, info)
+  }
+  private static let ourReseedCounter: mte_drbg_reseed_counter = {
+    (state) -> UInt64 in
+    let s = state!
+    let counter = innerInfo(s).pointee.reseed_counter!(s + ourInnerOff)
+    let unused = UInt64(loadInt(s, ourAvailOff) / loadInt(s, ourBlockOff))
+    return counter > unused ? counter - unused : 0
+  }
+  private static let ourStateSave: mte_drbg_state_save = {
+    (state, saved) in
+    // Save only the unused bytes, in order, zeroizing the rest of the saved
+    // ring. They start at the read position's offset within its block, so the
+    // write position stays a multiple of the block size when restored.
+    let s = state!
+    let block = loadInt(s, ourBlockOff)
+    let ring = loadInt(s, ourRingBytesOff)
+    let ringBuff = s + loadInt(s, ourRingOff)
+    let read = loadInt(s, ourReadOff)
+    let avail = loadInt(s, ourAvailOff)
+    let saveRead = read % block
+    let first = min(avail, ring - read)
+    let saveRing = saved! + ourSaveHdrBytes
+    saveInt(saved!, 0, saveRead)
+    saveInt(saved!, 8, avail)
+    saveRing.initializeMemory(as: UInt8.self, repeating: 0, count: saveRead)
+    (saveRing + saveRead).copyMemory(from: ringBuff + read, byteCount: first)
+    (saveRing + saveRead + first).copyMemory(from: ringBuff,
+                                             byteCount: avail - first)
+    (saveRing + saveRead + avail).initializeMemory(
+      as: UInt8.self, repeating: 0, count: ring - saveRead - avail)
+    innerInfo(s).pointee.state_save!(s + ourInnerOff, saveRing + ring)
+  }
+  private static let ourStateRestore: mte_drbg_state_restore = {
+    (state, saved) in
+    let s = state!
+    let ring = loadInt(s, ourRingBytesOff)
+    storeInt(s, ourReadOff, restoreInt(saved!, 0))
+    storeInt(s, ourAvailOff, restoreInt(saved!, 8))
+    (s + loadInt(s, ourRingOff)).copyMemory(from: saved! + ourSaveHdrBytes,
+                                            byteCount: ring)
+    innerInfo(s).pointee.state_restore!(s + ourInnerOff,
+                                        saved! + ourSaveHdrBytes + ring)
+  }
+  private static let ourGenerate: mte_drbg_generate = {
+    (state, bytes, randomNumber) -> mte_status in
+    let s = state!
+    let ring = loadInt(s, ourRingBytesOff)
+    let ringBuff = s + loadInt(s, ourRingOff)
+    var out = randomNumber!
+    var remaining = bytes
+    while remaining > 0 {
+      // Refill if empty.
+      if loadInt(s, ourAvailOff) == 0 {
+        let status = fillBlock(s)
+        if status != mte_status_success {
+          return status
+        }
+      }
+
+      // Copy as much as is contiguous, zeroizing what was used.
+      let read = loadInt(s, ourReadOff)
+      let avail = loadInt(s, ourAvailOff)
+      let n = min(remaining, min(avail, ring - read))
+      out.copyMemory(from: ringBuff + read, byteCount: n)
+      (ringBuff + read).initializeMemory(as: UInt8.self, repeating: 0, count: n)
+      storeInt(s, ourReadOff, (read + n) % ring)
+      storeInt(s, ourAvailOff, avail - n)
+      out += n
+      remaining -= n
+    }
+    return mte_status_success
+  }
+  private static let ourUninstantiate: mte_drbg_uninstantiate = {
+    (state) -> mte_status in
+    let s = state!
+    resetRing(s)
+    return innerInfo(s).pointee.uninstantiate!(s + ourInnerOff)
+  }
+
+  // State header offsets. The wrapped DRBG state follows the header and the
+  // ring follows that.
+  private static let ourInfoOff = 0
+  private static let ourBlockOff = 8
+  private static let ourRingBytesOff = 16
+  private static let ourRingOff = 24
+  private static let ourReadOff = 32
+  private static let ourAvailOff = 40
+  private static let ourInnerOff = 48
+
+  // Saved state header size. The read position and available bytes are saved
+  // first, then the ring, then the wrapped DRBG's saved state.
+  private static let ourSaveHdrBytes = 16
+
+  // The state and info.
+  private let myState: UnsafeMutableRawPointer
+  private let myInfo: UnsafeMutablePointer<mte_drbg_info>
+
+  // The multi-request generate callback of the wrapped DRBG and the requests
+  // buffer for it.
+  private let myGenerateMulti: MteDrbgGenerateMulti?
+  private var myRequests = [mte_verifier_drbg_gen]()
+}
@@ -37,7 +37,7 @@ import Mte
 //
 // Alternatively, the state can be saved any time after instantiate() and
 // restored instead of instantiate() to pick up at a known point.
-public class MteEnc : MteBase {
+public class MteEnc : MteBase, MteReseedCounter {
   // Initialize using default options.
   public override convenience init() throws {
     try self.init(MteBase.getDefaultDrbg(),
@@ -86,6 +86,68 @@ public class MteEnc : MteBase {
                            count: Int(mte_wrap_enc_save_bytes_b64(myEncoder)))
   }
 
+  // Initialize taking an external DRBG state and info, token size in bytes,
+  // and verifiers algorithm. The DRBG state and info must remain valid while
+  // the encoder is in use.
+  public init(_ drbgState: UnsafeMutableRawPointer,
+              _ drbgInfo: UnsafePointer<mte_drbg_info>,
+              _ tokBytes: Int,
+              _ verifiers: mte_verifiers) throws {
+    // Set up the init info.
+    var info = mte_enc_init_info()
+    info.enc_params.drbg_state = drbgState
+    info.enc_params.drbg_info = drbgInfo
+    info.enc_params.drbg = mte_drbgs_none
+    info.enc_params.verifiers = verifiers
+    info.enc_params.tok_bytes = tokBytes
+
+    // Get the encoder size.
+    let bytes = Int(mte_enc_state_bytes(&info))
+    if bytes == 0 {
+      throw MteError.logicError("MteEnc.init: Invalid options")
+    }
+
+    // Allocate the encoder.
+    myEncoder =
+      UnsafeMutableRawPointer.allocate(byteCount: bytes,
+                                       alignment: MemoryLayout<Int64>.alignment)
+
+    // Super.
+    try super.init()
+
+    // Initialize the base.
+    super.initBase(drbgInfo,
+                   tokBytes,
+                   verifiers,
+                   mte_ciphers_none,
+                   mte_hashes_none)
+
+    // Initialize the encoder state.
+    let status = mte_enc_state_init(myEncoder, &info)
+    if status != mte_status_success {
+      throw MteError.logicError("MteEnc.init: Invalid options")
+    }
+
+    // Allocate the save buffers.
+    mySaveBuff = [UInt8](repeating: 0,
+                         count: Int(mte_wrap_enc_save_bytes(myEncoder)))
+    mySaveBuff64 = [UInt8](repeating: 0,
+                           count: Int(mte_wrap_enc_save_bytes_b64(myEncoder)))
+  }
+
+  // Initialize taking a prefetching DRBG, token size in bytes, and verifiers
+  // algorithm. The encoder keeps a reference to the prefetching DRBG so it
+  // remains valid.
+  public convenience init(_ drbg: MteDrbgPrefetch,
+                          _ tokBytes: Int,
+                          _ verifiers: mte_verifiers) throws {
+    try self.init(drbg.getDrbgState(),
+                  drbg.getDrbgInfo(),
+                  tokBytes,
+                  verifiers)
+    myPrefetch = drbg
+  }
+
   // Deallocate. The uninstantiate method is called.
   deinit {
     // Uninstantiate.
@@ -177,28 +239,20 @@ public class MteEnc : MteBase {
   }
   public func encodeB64(_ data: [UInt8]) ->
   (encoded: String, status: mte_status) {
-    // Get the encode buffer requirement and resize if necessary.
+    // Get the encode buffer requirement.
     let buffBytes = mte_wrap_enc_buff_bytes_b64(myEncoder, UInt32(data.count))
-    MteBase.resizeArray(&myEncBuff, buffBytes)
 
     // Encode.
-    var status = mte_status_success
-    let b64 = myEncBuff.withUnsafeMutableBytes { (buff) -> String in
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    return MteBase.encodeB64String(Int(buffBytes), &myEncBuff) { buff in
       var eOff: UInt32 = 0
       var eBytes: UInt32 = 0
-      let uc = Unmanaged.passUnretained(self).toOpaque()
-      status = mte_wrap_enc_encode_b64(myEncoder,
-                                       MteBase.ourTimestampCallback, uc,
-                                       data, UInt32(data.count),
-                                       buff.baseAddress, &eOff, &eBytes)
-      if status != mte_status_success {
-        return String()
-      }
-      let buffOff = buff.baseAddress!.advanced(by: Int(eOff))
-      let buffOffC = buffOff.assumingMemoryBound(to: CChar.self)
-      return String(cString: buffOffC)
+      let status = mte_wrap_enc_encode_b64(myEncoder,
+                                           MteBase.ourTimestampCallback, uc,
+                                           data, UInt32(data.count),
+                                           buff, &eOff, &eBytes)
+      return (status, Int(eOff), Int(eBytes))
     }
-    return (b64, status)
   }
 
   // Encode the given string. Returns the encoded version and the status.
@@ -227,29 +281,21 @@ public class MteEnc : MteBase {
   }
   public func encodeB64(_ str: String) ->
   (encoded: String, status: mte_status) {
-    // Get the encode buffer requirement and resize if necessary.
+    // Get the encode buffer requirement.
     let buffBytes = mte_wrap_enc_buff_bytes_b64(myEncoder,
                                                 UInt32(str.utf8.count))
-    MteBase.resizeArray(&myEncBuff, buffBytes)
 
     // Encode.
-    var status = mte_status_success
-    let b64 = myEncBuff.withUnsafeMutableBytes { (buff) -> String in
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    return MteBase.encodeB64String(Int(buffBytes), &myEncBuff) { buff in
       var eOff: UInt32 = 0
       var eBytes: UInt32 = 0
-      let uc = Unmanaged.passUnretained(self).toOpaque()
-      status = mte_wrap_enc_encode_b64(myEncoder,
-                                       MteBase.ourTimestampCallback, uc,
-                                       str, UInt32(str.utf8.count),
-                                       buff.baseAddress, &eOff, &eBytes)
-      if status != mte_status_success {
-        return String()
-      }
-      let buffOff = buff.baseAddress!.advanced(by: Int(eOff))
-      let buffOffC = buffOff.assumingMemoryBound(to: CChar.self)
-      return String(cString: buffOffC)
+      let status = mte_wrap_enc_encode_b64(myEncoder,
+                                           MteBase.ourTimestampCallback, uc,
+                                           str, UInt32(str.utf8.count),
+                                           buff, &eOff, &eBytes)
+      return (status, Int(eOff), Int(eBytes))
     }
-    return (b64, status)
   }
 
   // Encode the given data of the given length at the given offset to the
@@ -301,6 +347,127 @@ public class MteEnc : MteBase {
     return (encOff + Int(eOff), Int(eBytes), status)
   }
 
+  // Encode the given segments joined as one message, exactly as if they were
+  // concatenated and passed to encode(). This is a convenience, not a
+  // zero-copy path: the segments are copied into a buffer kept between calls,
+  // which saves the caller assembling the message but not the copy. Returns
+  // the encoded version and the status.
+  public func encodeJoined(_ segments: [[UInt8]]) ->
+  (encoded: ArraySlice<UInt8>, status: mte_status) {
+    // Join the segments.
+    let dataBytes = MteBase.joinArray(&myJoinBuff, segments)
+
+    // Get the encode buffer requirement and resize if necessary.
+    let buffBytes = mte_wrap_enc_buff_bytes(myEncoder, UInt32(dataBytes))
+    MteBase.resizeArray(&myEncBuff, buffBytes)
+
+    // Encode.
+    var eOff: UInt32 = 0
+    var eBytes: UInt32 = 0
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    let status = myEncBuff.withUnsafeMutableBytes { buff in
+      mte_wrap_enc_encode(myEncoder,
+                          MteBase.ourTimestampCallback, uc,
+                          myJoinBuff, UInt32(dataBytes),
+                          buff.baseAddress, &eOff, &eBytes)
+    }
+    if status != mte_status_success {
+      return (ArraySlice<UInt8>(), status)
+    }
+
+    // Return the encoded part.
+    return (myEncBuff[Int(eOff)..<Int(eOff + eBytes)], status)
+  }
+  public func encodeJoinedB64(_ segments: [[UInt8]]) ->
+  (encoded: String, status: mte_status) {
+    // Join the segments.
+    let dataBytes = MteBase.joinArray(&myJoinBuff, segments)
+
+    // Get the encode buffer requirement.
+    let buffBytes = mte_wrap_enc_buff_bytes_b64(myEncoder,
+                                                UInt32(dataBytes))
+
+    // Encode.
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    return MteBase.encodeB64String(Int(buffBytes), &myEncBuff) { buff in
+      var eOff: UInt32 = 0
+      var eBytes: UInt32 = 0
+      let status = mte_wrap_enc_encode_b64(myEncoder,
+                                           MteBase.ourTimestampCallback, uc,
+                                           myJoinBuff, UInt32(dataBytes),
+                                           buff, &eOff, &eBytes)
+      return (status, Int(eOff), Int(eBytes))
+    }
+  }
+
+  // Encode each of the given data in order, exactly as if encode() were called
+  // on each one in turn. The encoded versions are packed one after another in
+  // a single buffer, sized once for the batch from each data's buffer
+  // requirement. Returns the buffer, the offset and length in bytes of each
+  // encoded version in the buffer, and the status. On error, the offsets and
+  // lengths describe only the data encoded before the error.
+  public func encodeBatch(_ data: [[UInt8]]) ->
+  (encoded: ArraySlice<UInt8>, offs: [Int], lens: [Int], status: mte_status) {
+    // Get the encode buffer requirements.
+    let buffBytes = data.map {
+      Int(mte_wrap_enc_buff_bytes(myEncoder, UInt32($0.count)))
+    }
+
+    // Encode.
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    let r = MteBase.packBatch(&myEncBuff, buffBytes, true) { i, buff in
+      var eOff: UInt32 = 0
+      var eBytes: UInt32 = 0
+      let status = mte_wrap_enc_encode(myEncoder,
+                                       MteBase.ourTimestampCallback, uc,
+                                       data[i], UInt32(data[i].count),
+                                       buff, &eOff, &eBytes)
+      return (status, Int(eOff), Int(eBytes))
+    }
+
+    // Return the encoded part.
+    return (myEncBuff[0..<r.end], r.offs, r.lens,
+            r.statuses.last ?? mte_status_success)
+  }
+  public func encodeBatchB64(_ data: [[UInt8]]) ->
+  (encoded: [String], status: mte_status) {
+    // Get the encode buffer requirements.
+    let buffBytes = data.map {
+      Int(mte_wrap_enc_buff_bytes_b64(myEncoder, UInt32($0.count)))
+    }
+
+    // Encode. Each null terminator is overwritten by the next encoded version.
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    let r = MteBase.packBatch(&myEncBuff, buffBytes, true) { i, buff in
+      var eOff: UInt32 = 0
+      var eBytes: UInt32 = 0
+      let status = mte_wrap_enc_encode_b64(myEncoder,
+                                           MteBase.ourTimestampCallback, uc,
+                                           data[i], UInt32(data[i].count),
+                                           buff, &eOff, &eBytes)
+      return (status, Int(eOff), Int(eBytes))
+    }
+
+    // Return the encoded versions as strings.
+    let encoded = myEncBuff.withUnsafeBytes { buff in
+      zip(r.offs, r.lens).map { (off, bytes) -> String in
+        String(decoding: UnsafeRawBufferPointer(rebasing:
+                                                  buff[off..<off + bytes]),
+               as: UTF8.self)
+      }
+    }
+    return (encoded, r.statuses.last ?? mte_status_success)
+  }
+
+  // Fill the prefetching DRBG's ring, if this encoder was created with one.
+  // Call this when idle. Returns the status.
+  public func prefetch() -> mte_status {
+    if myPrefetch == nil {
+      return mte_status_success
+    }
+    return myPrefetch!.prefetch(myPrefetch!.getRingBytes())
+  }
+
   // Uninstantiate the encoder. It is no longer usable after this call. Returns
   // the MTE status.
   public func uninstantiate() -> mte_status {
@@ -310,9 +477,15 @@ public class MteEnc : MteBase {
   // The encoder state.
   private let myEncoder: UnsafeMutableRawPointer
 
+  // The prefetching DRBG, if any.
+  private var myPrefetch: MteDrbgPrefetch? = nil
+
   // Encoder buffer.
   private var myEncBuff = [UInt8]()
 
+  // Buffer the segments are joined in.
+  private var myJoinBuff = [UInt8]()
+
   // State save buffer.
   private var mySaveBuff = [UInt8]()
   private var mySaveBuff64 = [UInt8]()
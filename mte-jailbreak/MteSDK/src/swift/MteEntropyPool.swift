@@ -0,0 +1,274 @@
+// The MIT License (MIT)
+//
+// Copyright (c) Eclypses, Inc.
+//
+// All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Imports when creating a Swift Package Manager package.
+#if MTE_SWIFT_PACKAGE_MANAGER
+import Mte
+#endif
+
+// Imports for background refill.
+import Dispatch
+
+// Imports for the system source.
+#if canImport(Security)
+import Security
+#endif
+
+// Class MteEntropyPool
+//
+// This is an entropy callback that supplies entropy from a pool of entries
+// instead of producing it during instantiation, so instantiation costs a copy
+// instead of a system call or network round trip.
+//
+// Each instantiation takes the next entry whole. Entries are added with add(),
+// such as shared secrets negotiated ahead of time, or produced by the source
+// given at initialization. With a source, the pool is refilled in the
+// background whenever it drops to half full, and an entry is produced
+// directly if the pool is empty. The default source is the system's secure
+// random number generator.
+//
+// To use, create an object of this type and pass it to setEntropyCallback() of
+// any number of encoders and decoders. This object is thread-safe, except that
+// an entry longer than the buffer MTE provides is returned from a buffer of
+// this object that the next such callback frees. Instantiations that may get
+// such entries must not overlap; shorter entries have no such limit.
+public class MteEntropyPool: MteEntropyCallback {
+  // An entropy source. It must fill the given array and return true, or
+  // return false if it cannot.
+  public typealias Source = (inout [UInt8]) -> Bool
+
+  // Initialize taking the entry size in bytes, the maximum number of entries,
+  // and the source, which may be nil to use only entries added with add().
+  // With a source, the pool is filled in the background right away.
+  public init(_ entryBytes: Int = 32,
+              _ maxEntries: Int = 64,
+              _ source: Source? = MteEntropyPool.systemSource) throws {
+    if entryBytes <= 0 || maxEntries <= 0 {
+      throw MteError.logicError("MteEntropyPool.init: Invalid options.")
+    }
+    myEntryBytes = entryBytes
+    myMaxEntries = maxEntries
+    mySource = source
+    startRefill()
+  }
+
+  // Deinitialize. The entries are zeroized first.
+  deinit {
+    for i in 0..<myEntries.count {
+      myEntries[i].resetBytes(in: 0..<myEntries[i].count)
+    }
+    freeLong(myLong, myLongBytes)
+  }
+
+  // The system source, which fills from the system's secure random number
+  // generator: in one SecRandomCopyBytes() call where available, otherwise 8
+  // bytes at a time from SystemRandomNumberGenerator.
+  public static func systemSource(_ entropy: inout [UInt8]) -> Bool {
+#if canImport(Security)
+    return SecRandomCopyBytes(kSecRandomDefault,
+                              entropy.count,
+                              &entropy) == errSecSuccess
+#else
+    var rng = SystemRandomNumberGenerator()
+    entropy.withUnsafeMutableBytes { buff in
+      var i = 0
+      while i < buff.count {
+        var r: UInt64 = rng.next()
+        let n = min(8, buff.count - i)
+        withUnsafeBytes(of: &r) { rbuff in
+          (buff.baseAddress! + i).copyMemory(from: rbuff.baseAddress!,
+                                             byteCount: n)
+        }
+        r = 0
+        i += n
+      }
+    }
+    return true
+#endif
+  }
+
+  // Add an entry, zeroizing the given entropy. The entry is dropped if the
+  // pool is full. Returns true if added, false if not.
+  @discardableResult
+  public func add(_ entropy: inout [UInt8]) -> Bool {
+    let entry = entropy
+    entropy.resetBytes(in: 0..<entropy.count)
+    return myLock.sync { () -> Bool in
+      if myEntries.count >= myMaxEntries {
+        return false
+      }
+      myEntries.append(entry)
+      return true
+    }
+  }
+
+  // Returns the number of entries in the pool.
+  public func getCount() -> Int {
+    return myLock.sync { myEntries.count }
+  }
+
+  // Returns the number of entries produced directly because the pool was
+  // empty.
+  public func getMissCount() -> UInt64 {
+    return myLock.sync { myMisses }
+  }
+
+  // Fill the pool from the source now, waiting until it is full. Returns true
+  // if full, false if there is no source or it failed.
+  @discardableResult
+  public func fill() -> Bool {
+    while getCount() < myMaxEntries {
+      guard let entry = produce() else {
+        return false
+      }
+      var e = entry
+      add(&e)
+    }
+    return true
+  }
+
+  // The entropy callback. Takes the next entry, or produces one from the
+  // source if the pool is empty.
+  public func entropyCallback(_ minEntropy: Int,
+                              _ minLength: Int,
+                              _ maxLength: UInt64,
+                              _ entropyInput: inout [UInt8],
+                              _ eiBytes: inout UInt64,
+                              _ entropyLong: inout UnsafeMutableRawPointer?) ->
+  mte_status {
+    // Take the next entry.
+    var entry = myLock.sync { () -> [UInt8]? in
+      return myEntries.isEmpty ? nil : myEntries.removeFirst()
+    }
+    if myLock.sync(execute: { myEntries.count }) <= myMaxEntries / 2 {
+      startRefill()
+    }
+    if entry == nil {
+      entry = produce()
+      if entry != nil {
+        myLock.sync { myMisses += 1 }
+      }
+    }
+    guard var ei = entry else {
+      return mte_status_drbg_catastrophic
+    }
+
+    // Drop the other reference so ei owns the entry's storage and zeroizing
+    // it clears the entry itself rather than a copy.
+    entry = nil
+    defer {
+      ei.resetBytes(in: 0..<ei.count)
+    }
+
+    // Check the length.
+    if ei.count < minEntropy || ei.count < minLength ||
+       UInt64(ei.count) > maxLength {
+      return mte_status_drbg_catastrophic
+    }
+
+    // Copy to the provided buffer if it fits, otherwise to our own.
+    if ei.count <= entropyInput.count {
+      entropyInput.replaceSubrange(0..<ei.count, with: ei)
+    } else {
+      // Swap the new buffer in under the lock so two such callbacks cannot
+      // free the same buffer, then free the one it replaces.
+      let long = UnsafeMutableRawPointer.allocate(byteCount: ei.count,
+                                                  alignment: 16)
+      ei.withUnsafeBytes { buff in
+        long.copyMemory(from: buff.baseAddress!, byteCount: ei.count)
+      }
+      let old = myLock.sync { () -> (UnsafeMutableRawPointer?, Int) in
+        let prev = (myLong, myLongBytes)
+        myLong = long
+        myLongBytes = ei.count
+        return prev
+      }
+      freeLong(old.0, old.1)
+      entropyLong = long
+    }
+    eiBytes = UInt64(ei.count)
+    return mte_status_success
+  }
+
+  // Produce an entry from the source. Returns nil if there is no source or it
+  // failed.
+  private func produce() -> [UInt8]? {
+    guard let source = mySource else {
+      return nil
+    }
+    var entry = [UInt8](repeating: 0, count: myEntryBytes)
+    return source(&entry) ? entry : nil
+  }
+
+  // Start a background refill if there is a source and one is not running.
+  private func startRefill() {
+    let start = myLock.sync { () -> Bool in
+      if mySource == nil || myRefilling {
+        return false
+      }
+      myRefilling = true
+      return true
+    }
+    if !start {
+      return
+    }
+    DispatchQueue.global(qos: .utility).async { [weak self] in
+      guard let pool = self else {
+        return
+      }
+      pool.fill()
+      pool.myLock.sync { pool.myRefilling = false }
+    }
+  }
+
+  // Zeroize and free the given entropy buffer of the given length in bytes.
+  private func freeLong(_ long: UnsafeMutableRawPointer?, _ bytes: Int) {
+    if let long = long {
+      long.initializeMemory(as: UInt8.self, repeating: 0, count: bytes)
+      long.deallocate()
+    }
+  }
+
+  // Options.
+  private let myEntryBytes: Int
+  private let myMaxEntries: Int
+  private let mySource: Source?
+
+  // Entries, oldest first, and the lock for all state shared with the
+  // background refill.
+  private var myEntries = [[UInt8]]()
+  private let myLock = DispatchQueue(label: "MteEntropyPool")
+
+  // True if a background refill is running.
+  private var myRefilling = false
+
+  // Number of entries produced directly.
+  private var myMisses = UInt64(0)
+
+  // Our own entropy buffer and its length, used if an entry is longer than
+  // the provided buffer. Each such callback replaces it under the lock, and
+  // it remains valid until the next one.
+  private var myLong: UnsafeMutableRawPointer? = nil
+  private var myLongBytes = 0
+}
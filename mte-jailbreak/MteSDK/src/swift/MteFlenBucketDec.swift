@@ -0,0 +1,123 @@
+// The MIT License (MIT)
+//
+// Copyright (c) Eclypses, Inc.
+//
+// All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Imports when creating a Swift Package Manager package.
+#if MTE_SWIFT_PACKAGE_MANAGER
+import Mte
+import Core
+#endif
+
+// Class MteFlenBucketDec
+//
+// This is the decoder for MteFlenBucketEnc. It holds one MteDec per size class
+// and decodes each message with the decoder of its class, which is found from
+// the encoded length. Sequencing, including catch-up, works within each class
+// as it does for a single MteDec.
+//
+// To use, create one MteDec per class with the same options as the encoders
+// and set up their entropy and nonce, then create an object of this type with
+// them and the encoded length of each class from
+// MteFlenBucketEnc.getEncodedBytes(). Call instantiate() with the same
+// personalization string as the encoder, then call decode() as with MteDec.
+//
+// Note: the decoders provided to this object cannot be used outside this
+// object as this object will change their states.
+public class MteFlenBucketDec {
+  // Initialize taking the decoders and the raw encoded length in bytes of each
+  // class, which must all differ, also once Base64 encoded.
+  public init(_ decoders: [MteDec], _ encodedBytes: [Int]) throws {
+    let b64Bytes = Set(encodedBytes.map { MteBase64.encodeBytes($0) })
+    if decoders.isEmpty || decoders.count != encodedBytes.count ||
+       b64Bytes.count != encodedBytes.count {
+      throw MteError.logicError("MteFlenBucketDec.init: Invalid options.")
+    }
+    myDecoders = decoders
+    for (i, bytes) in encodedBytes.enumerated() {
+      myClasses[bytes] = i
+      myClassesB64[MteBase64.encodeBytes(bytes)] = i
+    }
+  }
+
+  // Instantiate each class with the personalization string followed by the
+  // class number. Returns the status of the first failure or success.
+  public func instantiate(_ ps: [UInt8]) -> mte_status {
+    for i in 0..<myDecoders.count {
+      let status = myDecoders[i].instantiate(ps + [UInt8(i)])
+      if status != mte_status_success {
+        return status
+      }
+    }
+    return mte_status_success
+  }
+  public func instantiate(_ ps: String) -> mte_status {
+    return instantiate([UInt8](ps.utf8))
+  }
+
+  // Returns the decoder of the given class, to save or restore its state or
+  // get its timestamps and messages skipped.
+  public func getDecoder(_ sizeClass: Int) -> MteDec {
+    return myDecoders[sizeClass]
+  }
+
+  // Decode the given encoded version with the decoder of its class. Returns the
+  // decoded data, which is padded to the fixed length of its class, the class,
+  // and the status. If the encoded length matches no class, the class is -1
+  // and the status is mte_status_invalid_input.
+  public func decode(_ encoded: [UInt8]) ->
+  (decoded: ArraySlice<UInt8>, sizeClass: Int, status: mte_status) {
+    guard let c = myClasses[encoded.count] else {
+      return (ArraySlice<UInt8>(), -1, mte_status_invalid_input)
+    }
+    let r = myDecoders[c].decode(encoded)
+    return (r.decoded, c, r.status)
+  }
+  public func decodeB64(_ encoded: String) ->
+  (decoded: ArraySlice<UInt8>, sizeClass: Int, status: mte_status) {
+    guard let c = myClassesB64[encoded.utf8.count] else {
+      return (ArraySlice<UInt8>(), -1, mte_status_invalid_input)
+    }
+    let r = myDecoders[c].decodeB64(encoded)
+    return (r.decoded, c, r.status)
+  }
+
+  // Uninstantiate each class. Returns the status of the first failure or
+  // success.
+  public func uninstantiate() -> mte_status {
+    var status = mte_status_success
+    for dec in myDecoders {
+      let s = dec.uninstantiate()
+      if status == mte_status_success {
+        status = s
+      }
+    }
+    return status
+  }
+
+  // The decoders, one per class.
+  private let myDecoders: [MteDec]
+
+  // The class of each raw and Base64 encoded length in bytes.
+  private var myClasses = [Int: Int]()
+  private var myClassesB64 = [Int: Int]()
+}
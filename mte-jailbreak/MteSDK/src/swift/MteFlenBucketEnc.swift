@@ -0,0 +1,200 @@
+// The MIT License (MIT)
+//
+// Copyright (c) Eclypses, Inc.
+//
+// All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Imports when creating a Swift Package Manager package.
+#if MTE_SWIFT_PACKAGE_MANAGER
+import Mte
+import Core
+#endif
+
+// Class MteFlenBucketEnc
+//
+// This is a fixed-length encoder with several size classes (e.g. 64, 256, 1024
+// and 4096 bytes). Each message is padded to the smallest class that fits, so
+// the encoded length reveals only the class, not the exact length, without
+// padding every message to the largest class.
+//
+// Each class is a separate MteFlenEnc with its own random state, and is
+// decoded by its own MteDec, wrapped by MteFlenBucketDec. Sequencing,
+// including catch-up, works within each class as it does for a single
+// MteFlenEnc.
+//
+// To use, create one MteFlenEnc per class with the same options and set up
+// their entropy and nonce, then create an object of this type with them and
+// their fixed lengths. Call instantiate(), which instantiates each class with
+// the personalization string followed by the class number so no two classes
+// share a random state. Then call encode() as with MteFlenEnc. The decoder
+// finds the class from the encoded length; use getEncodedBytes() to get the
+// lengths to create MteFlenBucketDec with.
+//
+// Note: the encoders provided to this object cannot be used outside this
+// object as this object will change their states.
+public class MteFlenBucketEnc {
+  // Initialize taking the encoders and the fixed length in bytes each was
+  // created with, in increasing order of fixed length.
+  public init(_ encoders: [MteFlenEnc], _ fixedBytes: [Int]) throws {
+    if encoders.isEmpty || encoders.count != fixedBytes.count ||
+       fixedBytes[0] <= 0 {
+      throw MteError.logicError("MteFlenBucketEnc.init: Invalid options.")
+    }
+    for i in 1..<fixedBytes.count where fixedBytes[i] <= fixedBytes[i - 1] {
+      throw MteError.logicError("MteFlenBucketEnc.init: Invalid options.")
+    }
+    myEncoders = encoders
+    myFixedBytes = fixedBytes
+  }
+
+  // Instantiate each class with the personalization string followed by the
+  // class number. Returns the status of the first failure or success.
+  public func instantiate(_ ps: [UInt8]) -> mte_status {
+    for i in 0..<myEncoders.count {
+      let status = myEncoders[i].instantiate(ps + [UInt8(i)])
+      if status != mte_status_success {
+        return status
+      }
+    }
+    return mte_status_success
+  }
+  public func instantiate(_ ps: String) -> mte_status {
+    return instantiate([UInt8](ps.utf8))
+  }
+
+  // Returns the number of classes.
+  public func getClassCount() -> Int {
+    return myEncoders.count
+  }
+
+  // Returns the encoder of the given class, to save or restore its state.
+  public func getEncoder(_ sizeClass: Int) -> MteFlenEnc {
+    return myEncoders[sizeClass]
+  }
+
+  // Returns the class data of the given length in bytes is encoded with, which
+  // is the smallest that fits, or -1 if it is longer than the largest.
+  public func getClass(_ dataBytes: Int) -> Int {
+    for i in 0..<myFixedBytes.count where dataBytes <= myFixedBytes[i] {
+      return i
+    }
+    return -1
+  }
+
+  // Returns the encoded length in bytes of each class. The Base64 version
+  // returns the Base64-encoded lengths instead. These are found by encoding
+  // an empty message with each encoder and restoring its state afterward, so
+  // the encoders must be instantiated. On error, nil is returned.
+  public func getEncodedBytes() -> [Int]? {
+    return getEncodedBytes { enc in
+      let r = enc.encode([UInt8]())
+      return (r.encoded.count, r.status)
+    }
+  }
+  public func getEncodedBytesB64() -> [Int]? {
+    return getEncodedBytes { enc in
+      let r = enc.encodeB64([UInt8]())
+      return (r.encoded.utf8.count, r.status)
+    }
+  }
+
+  // Encode the given data with the class for its length. Returns the encoded
+  // version, the class, and the status. Data longer than the largest class is
+  // not encoded, rather than truncated, and gets mte_status_invalid_input and
+  // class -1.
+  public func encode(_ data: [UInt8]) ->
+  (encoded: ArraySlice<UInt8>, sizeClass: Int, status: mte_status) {
+    let c = getClass(data.count)
+    if c < 0 {
+      return ([], c, mte_status_invalid_input)
+    }
+    let r = myEncoders[c].encode(data)
+    return (r.encoded, c, r.status)
+  }
+  public func encodeB64(_ data: [UInt8]) ->
+  (encoded: String, sizeClass: Int, status: mte_status) {
+    let c = getClass(data.count)
+    if c < 0 {
+      return ("", c, mte_status_invalid_input)
+    }
+    let r = myEncoders[c].encodeB64(data)
+    return (r.encoded, c, r.status)
+  }
+
+  // Encode the given string with the class for its length. Returns the
+  // encoded version, the class, and the status. A string longer than the
+  // largest class is not encoded, as above.
+  public func encode(_ str: String) ->
+  (encoded: ArraySlice<UInt8>, sizeClass: Int, status: mte_status) {
+    let c = getClass(str.utf8.count)
+    if c < 0 {
+      return ([], c, mte_status_invalid_input)
+    }
+    let r = myEncoders[c].encode(str)
+    return (r.encoded, c, r.status)
+  }
+  public func encodeB64(_ str: String) ->
+  (encoded: String, sizeClass: Int, status: mte_status) {
+    let c = getClass(str.utf8.count)
+    if c < 0 {
+      return ("", c, mte_status_invalid_input)
+    }
+    let r = myEncoders[c].encodeB64(str)
+    return (r.encoded, c, r.status)
+  }
+
+  // Uninstantiate each class. Returns the status of the first failure or
+  // success.
+  public func uninstantiate() -> mte_status {
+    var status = mte_status_success
+    for enc in myEncoders {
+      let s = enc.uninstantiate()
+      if status == mte_status_success {
+        status = s
+      }
+    }
+    return status
+  }
+
+  // Returns the encoded length of each class using the given empty encode,
+  // restoring each encoder's state afterward. On error, nil is returned.
+  private func getEncodedBytes(_ encodeEmpty: (MteFlenEnc) ->
+                               (bytes: Int, status: mte_status)) -> [Int]? {
+    var bytes = [Int]()
+    for enc in myEncoders {
+      guard let saved = enc.saveState() else {
+        return nil
+      }
+      let r = encodeEmpty(enc)
+      if enc.restoreState(saved) != mte_status_success ||
+         r.status != mte_status_success {
+        return nil
+      }
+      bytes.append(r.bytes)
+    }
+    return bytes
+  }
+
+  // The encoders, one per class, and their fixed lengths in bytes.
+  private let myEncoders: [MteFlenEnc]
+  private let myFixedBytes: [Int]
+}
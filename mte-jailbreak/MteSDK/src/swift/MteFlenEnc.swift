@@ -38,7 +38,7 @@ import Core
 //
 // Alternatively, the state can be saved any time after instantiate() and
 // restored instead of instantiate() to pick up at a known point.
-public class MteFlenEnc : MteBase {
+public class MteFlenEnc : MteBase, MteReseedCounter {
   // Initialize using default options.
   //
   // The fixed length in bytes is required.
@@ -186,28 +186,21 @@ public class MteFlenEnc : MteBase {
   }
   public func encodeB64(_ data: [UInt8]) ->
   (encoded: String, status: mte_status) {
-    // Get the encode buffer requirement and resize if necessary.
+    // Get the encode buffer requirement.
     let buffBytes = mte_wrap_flen_enc_buff_bytes_b64(myEncoder)
-    MteBase.resizeArray(&myEncBuff, buffBytes)
 
     // Encode.
-    var status = mte_status_success
-    let b64 = myEncBuff.withUnsafeMutableBytes { (buff) -> String in
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    return MteBase.encodeB64String(Int(buffBytes), &myEncBuff) { buff in
       var eOff: UInt32 = 0
       var eBytes: UInt32 = 0
-      let uc = Unmanaged.passUnretained(self).toOpaque()
-      status = mte_wrap_flen_enc_encode_b64(myEncoder,
-                                            MteBase.ourTimestampCallback, uc,
-                                            data, UInt32(data.count),
-                                            buff.baseAddress, &eOff, &eBytes)
-      if status != mte_status_success {
-        return String()
-      }
-      let buffOff = buff.baseAddress!.advanced(by: Int(eOff))
-      let buffOffC = buffOff.assumingMemoryBound(to: CChar.self)
-      return String(cString: buffOffC)
+      let status =
+        mte_wrap_flen_enc_encode_b64(myEncoder,
+                                     MteBase.ourTimestampCallback, uc,
+                                     data, UInt32(data.count),
+                                     buff, &eOff, &eBytes)
+      return (status, Int(eOff), Int(eBytes))
     }
-    return (b64, status)
   }
 
   // Encode the given string. Returns the encoded version and the status.
@@ -236,28 +229,21 @@ public class MteFlenEnc : MteBase {
   }
   public func encodeB64(_ str: String) ->
   (encoded: String, status: mte_status) {
-    // Get the encode buffer requirement and resize if necessary.
+    // Get the encode buffer requirement.
     let buffBytes = mte_wrap_flen_enc_buff_bytes_b64(myEncoder)
-    MteBase.resizeArray(&myEncBuff, buffBytes)
 
     // Encode.
-    var status = mte_status_success
-    let b64 = myEncBuff.withUnsafeMutableBytes { (buff) -> String in
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    return MteBase.encodeB64String(Int(buffBytes), &myEncBuff) { buff in
       var eOff: UInt32 = 0
       var eBytes: UInt32 = 0
-      let uc = Unmanaged.passUnretained(self).toOpaque()
-      status = mte_wrap_flen_enc_encode_b64(myEncoder,
-                                            MteBase.ourTimestampCallback, uc,
-                                            str, UInt32(str.utf8.count),
-                                            buff.baseAddress, &eOff, &eBytes)
-      if status != mte_status_success {
-        return String()
-      }
-      let buffOff = buff.baseAddress!.advanced(by: Int(eOff))
-      let buffOffC = buffOff.assumingMemoryBound(to: CChar.self)
-      return String(cString: buffOffC)
+      let status =
+        mte_wrap_flen_enc_encode_b64(myEncoder,
+                                     MteBase.ourTimestampCallback, uc,
+                                     str, UInt32(str.utf8.count),
+                                     buff, &eOff, &eBytes)
+      return (status, Int(eOff), Int(eBytes))
     }
-    return (b64, status)
   }
 
   // Encode the given data of the given length at the given offset to the
@@ -308,6 +294,59 @@ public class MteFlenEnc : MteBase {
     return (encOff + Int(eOff), Int(eBytes), status)
   }
 
+  // Encode the given segments joined as one message, exactly as if they were
+  // concatenated and passed to encode(). This is a convenience, not a
+  // zero-copy path: the segments are copied into a buffer kept between calls,
+  // which saves the caller assembling the message but not the copy. Returns
+  // the encoded version and the status.
+  public func encodeJoined(_ segments: [[UInt8]]) ->
+  (encoded: ArraySlice<UInt8>, status: mte_status) {
+    // Join the segments.
+    let dataBytes = MteBase.joinArray(&myJoinBuff, segments)
+
+    // Get the encode buffer requirement and resize if necessary.
+    let buffBytes = mte_wrap_flen_enc_buff_bytes(myEncoder)
+    MteBase.resizeArray(&myEncBuff, buffBytes)
+
+    // Encode.
+    var eOff: UInt32 = 0
+    var eBytes: UInt32 = 0
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    let status = myEncBuff.withUnsafeMutableBytes { buff in
+      mte_wrap_flen_enc_encode(myEncoder,
+                               MteBase.ourTimestampCallback, uc,
+                               myJoinBuff, UInt32(dataBytes),
+                               buff.baseAddress, &eOff, &eBytes)
+    }
+    if status != mte_status_success {
+      return (ArraySlice<UInt8>(), status)
+    }
+
+    // Return the encoded part.
+    return (myEncBuff[Int(eOff)..<Int(eOff + eBytes)], status)
+  }
+  public func encodeJoinedB64(_ segments: [[UInt8]]) ->
+  (encoded: String, status: mte_status) {
+    // Join the segments.
+    let dataBytes = MteBase.joinArray(&myJoinBuff, segments)
+
+    // Get the encode buffer requirement.
+    let buffBytes = mte_wrap_flen_enc_buff_bytes_b64(myEncoder)
+
+    // Encode.
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    return MteBase.encodeB64String(Int(buffBytes), &myEncBuff) { buff in
+      var eOff: UInt32 = 0
+      var eBytes: UInt32 = 0
+      let status =
+        mte_wrap_flen_enc_encode_b64(myEncoder,
+                                     MteBase.ourTimestampCallback, uc,
+                                     myJoinBuff, UInt32(dataBytes),
+                                     buff, &eOff, &eBytes)
+      return (status, Int(eOff), Int(eBytes))
+    }
+  }
+
   // Uninstantiate the encoder. It is no longer usable after this call. Returns
   // the MTE status.
   public func uninstantiate() -> mte_status {
@@ -320,6 +359,9 @@ public class MteFlenEnc : MteBase {
   // Encoder buffer.
   private var myEncBuff = [UInt8]()
 
+  // Buffer the segments are joined in.
+  private var myJoinBuff = [UInt8]()
+
   // State save buffer.
   private var mySaveBuff = [UInt8]()
   private var mySaveBuff64 = [UInt8]()
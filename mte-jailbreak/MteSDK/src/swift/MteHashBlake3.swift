@@ -0,0 +1,540 @@
+// The MIT License (MIT)
+//
+// Copyright (c) Eclypses, Inc.
+//
+// All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Imports when creating a Swift Package Manager package.
+#if MTE_SWIFT_PACKAGE_MANAGER
+import Mte
+#endif
+import Dispatch
+
+// Class MteHashBlake3
+//
+// This is an external hash implementing BLAKE3 with a 32-byte digest, for
+// large MKE payloads where a SHA-2 hash over the whole message becomes the
+// bottleneck.
+//
+// BLAKE3 splits the input into 1 KiB chunks that are the leaves of a binary
+// tree. The chunks are independent, so full chunks are compressed 4 at a time
+// by the same compression function instantiated for SIMD4<UInt32> words, one
+// chunk per lane, with the message words transposed so lane k holds chunk k.
+// When a single feed has enough full chunks and parallel hashing is enabled,
+// they are also spread over threads with DispatchQueue.concurrentPerform. The
+// chunk chaining values are then merged into the tree in order, which is a
+// small fraction of the work. The digest does not depend on the threads used
+// or on how the input is split across feeds.
+//
+// To use, create an object of this type and pass mte_hashes_none,
+// getHashState() and getHashInfo() to the external cipher and hash
+// initializer of MteMkeEnc or MteMkeDec. The encoder and decoder must both use
+// this hash.
+//
+// This object must remain valid while the encoder or decoder is in use, and
+// may only be used by one encoder or decoder at a time.
+public class MteHashBlake3 {
+  // Initialize. If parallel is true, large feeds are hashed using multiple
+  // threads.
+  public init(_ parallel: Bool = true) {
+    myState = UnsafeMutableRawPointer.allocate(
+      byteCount: MteHashBlake3.ourStateBytes, alignment: 16)
+    myState.initializeMemory(as: UInt8.self,
+                             repeating: 0,
+                             count: MteHashBlake3.ourStateBytes)
+    myState.storeBytes(of: parallel ? UInt64(1) : UInt64(0),
+                       toByteOffset: MteHashBlake3.ourParallelOff,
+                       as: UInt64.self)
+  }
+
+  // Deallocate. The state is zeroized first.
+  deinit {
+    myState.initializeMemory(as: UInt8.self,
+                             repeating: 0,
+                             count: MteHashBlake3.ourStateBytes)
+    myState.deallocate()
+  }
+
+  // Returns the hash state and info to pass to an external hash initializer.
+  public func getHashState() -> UnsafeMutableRawPointer { return myState }
+  public func getHashInfo() -> UnsafePointer<mte_hash_info> {
+    return UnsafePointer(MteHashBlake3.ourInfo)
+  }
+
+  // Returns the digest of the given bytes. This uses the same state as the
+  // hash callbacks, so it must not be called while an encoder or decoder is
+  // using this object.
+  public func hash(_ data: [UInt8]) -> [UInt8] {
+    MteHashBlake3.start(myState)
+    data.withUnsafeBytes { dbuff in
+      if dbuff.count != 0 {
+        MteHashBlake3.feed(myState, dbuff.baseAddress!, dbuff.count)
+      }
+    }
+    let digest = MteHashBlake3.finish(myState)
+    return [UInt8](UnsafeRawBufferPointer(start: digest,
+                                          count: MteHashBlake3.ourDigestBytes))
+  }
+
+  // The G function, mixing a column or diagonal of the state.
+  @inline(__always)
+  private static func g<W: MteBlake3Word>(_ a: inout W, _ b: inout W,
+                                          _ c: inout W, _ d: inout W,
+                                          _ x: W, _ y: W) {
+    a = a &+ b &+ x; d = (d ^ a).rotr(16)
+    c = c &+ d; b = (b ^ c).rotr(12)
+    a = a &+ b &+ y; d = (d ^ a).rotr(8)
+    c = c &+ d; b = (b ^ c).rotr(7)
+  }
+
+  // The compression function. The chaining value h is replaced by that of the
+  // message block m with the given counter, block length and flags.
+  @inline(__always)
+  private static func compress<W: MteBlake3Word>(
+    _ h: UnsafeMutablePointer<W>,
+    _ m: UnsafePointer<W>,
+    _ counter: (W, W),
+    _ len: W,
+    _ flags: W) {
+    var v0 = h[0], v1 = h[1], v2 = h[2], v3 = h[3]
+    var v4 = h[4], v5 = h[5], v6 = h[6], v7 = h[7]
+    var v8 = W(word: ourIv[0]), v9 = W(word: ourIv[1])
+    var v10 = W(word: ourIv[2]), v11 = W(word: ourIv[3])
+    var v12 = counter.0, v13 = counter.1, v14 = len, v15 = flags
+
+    // Do the 7 rounds, each with the next permutation of the message.
+    let s = ourSchedule
+    for r in stride(from: 0, to: s.count, by: 16) {
+      g(&v0, &v4, &v8, &v12, m[s[r]], m[s[r + 1]])
+      g(&v1, &v5, &v9, &v13, m[s[r + 2]], m[s[r + 3]])
+      g(&v2, &v6, &v10, &v14, m[s[r + 4]], m[s[r + 5]])
+      g(&v3, &v7, &v11, &v15, m[s[r + 6]], m[s[r + 7]])
+      g(&v0, &v5, &v10, &v15, m[s[r + 8]], m[s[r + 9]])
+      g(&v1, &v6, &v11, &v12, m[s[r + 10]], m[s[r + 11]])
+      g(&v2, &v7, &v8, &v13, m[s[r + 12]], m[s[r + 13]])
+      g(&v3, &v4, &v9, &v14, m[s[r + 14]], m[s[r + 15]])
+    }
+
+    h[0] = v0 ^ v8; h[1] = v1 ^ v9; h[2] = v2 ^ v10; h[3] = v3 ^ v11
+    h[4] = v4 ^ v12; h[5] = v5 ^ v13; h[6] = v6 ^ v14; h[7] = v7 ^ v15
+  }
+
+  // Load the block of the given length in bytes (at most 64) at the given data
+  // into the message words, zero padding it.
+  private static func loadBlock(_ data: UnsafeRawPointer,
+                                _ bytes: Int,
+                                _ m: UnsafeMutablePointer<UInt32>) {
+    for i in 0..<16 {
+      m[i] = 0
+    }
+    UnsafeMutableRawPointer(m).copyMemory(from: data, byteCount: bytes)
+    for i in 0..<16 {
+      m[i] = UInt32(littleEndian: m[i])
+    }
+  }
+
+  // Compute the chaining value of the chunk at the given data, which has the
+  // given length in bytes (at most a chunk), to cv. The given flags are added
+  // to those of the last block. The rest is a scratch buffer of 16 words.
+  private static func hashChunk(_ data: UnsafeRawPointer,
+                                _ bytes: Int,
+                                _ chunk: UInt64,
+                                _ endFlags: UInt32,
+                                _ cv: UnsafeMutablePointer<UInt32>,
+                                _ m: UnsafeMutablePointer<UInt32>) {
+    for i in 0..<8 {
+      cv[i] = ourIv[i]
+    }
+    let counter = (UInt32(truncatingIfNeeded: chunk),
+                   UInt32(truncatingIfNeeded: chunk >> 32))
+    let blocks = max(1, (bytes + ourBlockBytes - 1) / ourBlockBytes)
+    for b in 0..<blocks {
+      let n = min(ourBlockBytes, bytes - ourBlockBytes * b)
+      loadBlock(data + ourBlockBytes * b, n, m)
+      var flags = b == 0 ? ourChunkStart : 0
+      if b == blocks - 1 {
+        flags |= ourChunkEnd | endFlags
+      }
+      compress(cv, m, counter, UInt32(n), flags)
+    }
+  }
+
+  // Compute the chaining values of 4 full chunks at the given data, starting
+  // at the given chunk counter, to cvs. The rest are scratch buffers of 64
+  // words, 16 vectors and 8 vectors.
+  private static func hashChunks4(_ data: UnsafeRawPointer,
+                                  _ chunk: UInt64,
+                                  _ cvs: UnsafeMutablePointer<UInt32>,
+                                  _ words: UnsafeMutablePointer<UInt32>,
+                                  _ m: UnsafeMutablePointer<SIMD4<UInt32>>,
+                                  _ h: UnsafeMutablePointer<SIMD4<UInt32>>) {
+    // Each lane is one chunk.
+    for i in 0..<8 {
+      h[i] = SIMD4<UInt32>(repeating: ourIv[i])
+    }
+    let c = SIMD4<UInt64>(repeating: chunk) &+ SIMD4<UInt64>(0, 1, 2, 3)
+    let counter = (SIMD4<UInt32>(truncatingIfNeeded: c),
+                   SIMD4<UInt32>(truncatingIfNeeded: c &>> 32))
+    let len = SIMD4<UInt32>(repeating: UInt32(ourBlockBytes))
+    let blocks = ourChunkBytes / ourBlockBytes
+    for b in 0..<blocks {
+      // Gather the block from each chunk and transpose it into lanes.
+      for lane in 0..<4 {
+        UnsafeMutableRawPointer(words + 16 * lane).copyMemory(
+          from: data + ourChunkBytes * lane + ourBlockBytes * b,
+          byteCount: ourBlockBytes)
+      }
+      transpose(words, m)
+      let flags = b == 0 ? ourChunkStart :
+        b == blocks - 1 ? ourChunkEnd : 0
+      compress(h, m, counter, len, SIMD4<UInt32>(repeating: flags))
+    }
+
+    // Write each lane as a chaining value.
+    for lane in 0..<4 {
+      for i in 0..<8 {
+        cvs[8 * lane + i] = h[i][lane]
+      }
+    }
+  }
+
+  // Transpose the 4 message blocks of 16 words into 16 vectors, one block per
+  // lane, converting from little-endian.
+  @inline(__always)
+  private static func transpose(_ words: UnsafePointer<UInt32>,
+                                _ m: UnsafeMutablePointer<SIMD4<UInt32>>) {
+    for i in 0..<16 {
+      m[i] = SIMD4<UInt32>(UInt32(littleEndian: words[i]),
+                           UInt32(littleEndian: words[16 + i]),
+                           UInt32(littleEndian: words[32 + i]),
+                           UInt32(littleEndian: words[48 + i]))
+    }
+  }
+
+  // Compute the chaining values of the given number of full chunks at the
+  // given data, starting at the given chunk counter, to cvs.
+  private static func hashChunks(_ data: UnsafeRawPointer,
+                                 _ count: Int,
+                                 _ chunk: UInt64,
+                                 _ cvs: UnsafeMutablePointer<UInt32>) {
+    let words = UnsafeMutablePointer<UInt32>.allocate(capacity: 64)
+    let m = UnsafeMutablePointer<SIMD4<UInt32>>.allocate(capacity: 16)
+    let h = UnsafeMutablePointer<SIMD4<UInt32>>.allocate(capacity: 8)
+    defer {
+      words.deallocate()
+      m.deallocate()
+      h.deallocate()
+    }
+    var i = 0
+    while i + 4 <= count {
+      hashChunks4(data + ourChunkBytes * i, chunk + UInt64(i), cvs + 8 * i,
+                  words, m, h)
+      i += 4
+    }
+    while i < count {
+      hashChunk(data + ourChunkBytes * i, ourChunkBytes, chunk + UInt64(i), 0,
+                cvs + 8 * i, words)
+      i += 1
+    }
+  }
+
+  // Compute the parent chaining value of the given left and right chaining
+  // values to out, which may be either of them. The given flags are added.
+  // The rest is a scratch buffer of 16 words.
+  private static func parent(_ left: UnsafePointer<UInt32>,
+                             _ right: UnsafePointer<UInt32>,
+                             _ flags: UInt32,
+                             _ out: UnsafeMutablePointer<UInt32>,
+                             _ m: UnsafeMutablePointer<UInt32>) {
+    for i in 0..<8 {
+      m[i] = left[i]
+      m[8 + i] = right[i]
+    }
+    for i in 0..<8 {
+      out[i] = ourIv[i]
+    }
+    compress(out, m, (0, 0), UInt32(ourBlockBytes), ourParent | flags)
+  }
+
+  // Returns the chaining value stack in the state.
+  private static func getStack(
+    _ s: UnsafeMutableRawPointer) -> UnsafeMutablePointer<UInt32> {
+    return (s + ourStackOff).bindMemory(to: UInt32.self,
+                                        capacity: 8 * ourStackEntries)
+  }
+
+  // Returns the scratch message words and chaining value in the state. They
+  // are only used on the thread calling the hash, not by hashing threads.
+  private static func getScratch(_ s: UnsafeMutableRawPointer) ->
+  (m: UnsafeMutablePointer<UInt32>, cv: UnsafeMutablePointer<UInt32>) {
+    let m = (s + ourScratchOff).bindMemory(to: UInt32.self, capacity: 24)
+    return (m, m + 16)
+  }
+
+  // Add the given chaining values of consecutive chunks to the tree. Each
+  // chunk completes as many subtrees as its count has trailing zero bits,
+  // which are merged off the top of the stack.
+  private static func addChunkCvs(_ s: UnsafeMutableRawPointer,
+                                  _ cvs: UnsafePointer<UInt32>,
+                                  _ count: Int) {
+    let stack = getStack(s)
+    var chunks = s.load(fromByteOffset: ourChunksOff, as: UInt64.self)
+    var depth = s.load(fromByteOffset: ourDepthOff, as: Int.self)
+    let (m, _) = getScratch(s)
+    for i in 0..<count {
+      for j in 0..<8 {
+        stack[8 * depth + j] = cvs[8 * i + j]
+      }
+      chunks += 1
+      var total = chunks
+      while total & 1 == 0 {
+        parent(stack + 8 * (depth - 1), stack + 8 * depth, 0,
+               stack + 8 * (depth - 1), m)
+        depth -= 1
+        total >>= 1
+      }
+      depth += 1
+    }
+    s.storeBytes(of: chunks, toByteOffset: ourChunksOff, as: UInt64.self)
+    s.storeBytes(of: depth, toByteOffset: ourDepthOff, as: Int.self)
+  }
+
+  // Hash the given number of full chunks at the given data and add them to
+  // the tree. The chunks are done in slabs; the chunks of a large slab are
+  // spread over threads if enabled.
+  private static func hashFullChunks(_ s: UnsafeMutableRawPointer,
+                                     _ data: UnsafeRawPointer,
+                                     _ count: Int) {
+    // A single chunk, such as a full buffered one, is hashed in the scratch
+    // area.
+    if count == 1 {
+      let (m, cv) = getScratch(s)
+      hashChunk(data, ourChunkBytes,
+                s.load(fromByteOffset: ourChunksOff, as: UInt64.self), 0, cv, m)
+      addChunkCvs(s, cv, 1)
+      return
+    }
+
+    // Otherwise the chaining values of a slab are buffered.
+    let parallel =
+      s.load(fromByteOffset: ourParallelOff, as: UInt64.self) != 0
+    let cvs = UnsafeMutablePointer<UInt32>.allocate(
+      capacity: 8 * min(count, ourSlabChunks))
+    defer { cvs.deallocate() }
+    var done = 0
+    while done < count {
+      let n = min(ourSlabChunks, count - done)
+      let chunk = s.load(fromByteOffset: ourChunksOff, as: UInt64.self)
+      let slab = data + ourChunkBytes * done
+      if parallel && n >= 2 * ourTaskChunks {
+        let tasks = (n + ourTaskChunks - 1) / ourTaskChunks
+        DispatchQueue.concurrentPerform(iterations: tasks) { t in
+          let first = ourTaskChunks * t
+          hashChunks(slab + ourChunkBytes * first,
+                     min(ourTaskChunks, n - first),
+                     chunk + UInt64(first),
+                     cvs + 8 * first)
+        }
+      } else {
+        hashChunks(slab, n, chunk, cvs)
+      }
+      addChunkCvs(s, cvs, n)
+      done += n
+    }
+  }
+
+  // Start a hash.
+  private static func start(_ s: UnsafeMutableRawPointer) {
+    s.storeBytes(of: 0, toByteOffset: ourBuffBytesOff, as: Int.self)
+    s.storeBytes(of: UInt64(0), toByteOffset: ourChunksOff, as: UInt64.self)
+    s.storeBytes(of: 0, toByteOffset: ourDepthOff, as: Int.self)
+  }
+
+  // Feed the given bytes to the hash. The last chunk so far is kept in the
+  // buffer, since it is hashed differently if it turns out to be the root.
+  private static func feed(_ s: UnsafeMutableRawPointer,
+                           _ data: UnsafeRawPointer,
+                           _ bytes: Int) {
+    let buff = s + ourBuffOff
+    var buffBytes = s.load(fromByteOffset: ourBuffBytesOff, as: Int.self)
+    var off = 0
+    while off < bytes {
+      // There is more input, so a full buffered chunk is not the last.
+      if buffBytes == ourChunkBytes {
+        hashFullChunks(s, buff, 1)
+        buffBytes = 0
+      }
+
+      // Hash full chunks directly from the input, leaving the last one.
+      if buffBytes == 0 {
+        let count = (bytes - off - 1) / ourChunkBytes
+        if count != 0 {
+          hashFullChunks(s, data + off, count)
+          off += ourChunkBytes * count
+        }
+      }
+
+      // Buffer the rest.
+      let n = min(ourChunkBytes - buffBytes, bytes - off)
+      (buff + buffBytes).copyMemory(from: data + off, byteCount: n)
+      buffBytes += n
+      off += n
+    }
+    s.storeBytes(of: buffBytes, toByteOffset: ourBuffBytesOff, as: Int.self)
+  }
+
+  // Finish the hash, returning a pointer to the digest in the state.
+  private static func finish(_ s: UnsafeMutableRawPointer) -> UnsafeRawPointer {
+    let stack = getStack(s)
+    var depth = s.load(fromByteOffset: ourDepthOff, as: Int.self)
+    let (m, cv) = getScratch(s)
+
+    // The buffered chunk is the root if it is the only chunk; otherwise merge
+    // it with the stack, the last merge being the root.
+    hashChunk(s + ourBuffOff,
+              s.load(fromByteOffset: ourBuffBytesOff, as: Int.self),
+              s.load(fromByteOffset: ourChunksOff, as: UInt64.self),
+              depth == 0 ? ourRoot : 0,
+              cv, m)
+    while depth > 0 {
+      depth -= 1
+      parent(stack + 8 * depth, cv, depth == 0 ? ourRoot : 0, cv, m)
+    }
+
+    // Write the digest.
+    for i in 0..<8 {
+      s.storeBytes(of: cv[i].littleEndian,
+                   toByteOffset: ourDigestOff + 4 * i,
+                   as: UInt32.self)
+    }
+    return UnsafeRawPointer(s + ourDigestOff)
+  }
+
+  // Hash callbacks.
+  private static let ourCalc: mte_hash_calc = {
+    (state, data, bytes) -> UnsafeRawPointer? in
+    let s = state!
+    start(s)
+    if bytes != 0 {
+      feed(s, data!, bytes)
+    }
+    return finish(s)
+  }
+  private static let ourStart: mte_hash_start = {
+    (state) in
+    start(state!)
+  }
+  private static let ourFeed: mte_hash_feed = {
+    (state, data, bytes) -> mte_status in
+    if bytes != 0 {
+      feed(state!, data!, bytes)
+    }
+    return mte_status_success
+  }
+  private static let ourFinish: mte_hash_finish = {
+    (state) -> UnsafeRawPointer? in
+    return finish(state!)
+  }
+
+  // The hash info, shared by all objects of this type.
+  private static let ourInfo: UnsafeMutablePointer<mte_hash_info> = {
+    let info = UnsafeMutablePointer<mte_hash_info>.allocate(capacity: 1)
+    info.initialize(to: mte_hash_info())
+    info.pointee.state_bytes = .init(ourStateBytes)
+    info.pointee.digest_bytes = .init(ourDigestBytes)
+    info.pointee.calc = ourCalc
+    info.pointee.start = ourStart
+    info.pointee.feed = ourFeed
+    info.pointee.finish = ourFinish
+    return info
+  }()
+
+  // The initialization vector, which is that of SHA-256.
+  private static let ourIv: [UInt32] = [
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  ]
+
+  // The message word order for each of the 7 rounds. Each round permutes the
+  // order of the previous one.
+  private static let ourSchedule: [Int] = {
+    let perm = [2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8]
+    var order = Array(0..<16)
+    var schedule = order
+    for _ in 1..<7 {
+      order = perm.map { order[$0] }
+      schedule += order
+    }
+    return schedule
+  }()
+
+  // Flags.
+  private static let ourChunkStart = UInt32(1)
+  private static let ourChunkEnd = UInt32(2)
+  private static let ourParent = UInt32(4)
+  private static let ourRoot = UInt32(8)
+
+  // Sizes. Slabs bound the chaining value buffer; tasks are the chunks hashed
+  // by one thread.
+  private static let ourBlockBytes = 64
+  private static let ourChunkBytes = 1024
+  private static let ourDigestBytes = 32
+  private static let ourSlabChunks = 4096
+  private static let ourTaskChunks = 64
+
+  // State layout. The stack holds a chaining value for each level of the tree
+  // (enough for 2^64 bytes) and one being merged. The scratch area holds the
+  // message words and chaining value used while adding chunks and finishing.
+  private static let ourStackEntries = 55
+  private static let ourStackOff = 0
+  private static let ourBuffOff = 1760
+  private static let ourBuffBytesOff = 2784
+  private static let ourChunksOff = 2792
+  private static let ourDepthOff = 2800
+  private static let ourDigestOff = 2808
+  private static let ourParallelOff = 2840
+  private static let ourScratchOff = 2848
+  private static let ourStateBytes = 2944
+
+  // The state.
+  private let myState: UnsafeMutableRawPointer
+}
+
+// The word types the compression function is generic over: UInt32 for one
+// block, and SIMD4<UInt32> for a block from each of 4 chunks.
+fileprivate protocol MteBlake3Word {
+  init(word: UInt32)
+  static func &+(a: Self, b: Self) -> Self
+  static func ^(a: Self, b: Self) -> Self
+  func rotr(_ n: UInt32) -> Self
+}
+extension UInt32: MteBlake3Word {
+  fileprivate init(word: UInt32) { self = word }
+  fileprivate func rotr(_ n: UInt32) -> UInt32 {
+    return (self >> n) | (self << (32 - n))
+  }
+}
+extension SIMD4: MteBlake3Word where Scalar == UInt32 {
+  fileprivate init(word: UInt32) { self.init(repeating: word) }
+  fileprivate func rotr(_ n: UInt32) -> SIMD4<UInt32> {
+    return (self &>> n) | (self &<< (32 - n))
+  }
+}
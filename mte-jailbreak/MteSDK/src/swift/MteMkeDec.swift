@@ -41,7 +41,7 @@ import Core
 //
 // To use as a chunk-based decryptor, call startDecrypt(), call decryptChunk()
 // zero or more times to decrypt each chunk of data, then finishDecrypt().
-public class MteMkeDec : MteBase {
+public class MteMkeDec : MteBase, MteReseedCounter {
   // Initialize using default options.
   //
   // The timestamp window and sequence window are optionally settable.
@@ -111,6 +111,80 @@ public class MteMkeDec : MteBase {
                          count: Int(mte_wrap_mke_dec_save_bytes_b64(myDecoder)))
   }
 
+  // Initialize taking the DRBG, token size in bytes, verifiers algorithm,
+  // cipher algorithm, hash algorithm, external cipher and hash states and
+  // infos, timestamp window, and sequence window. The external cipher is used
+  // if the cipher algorithm is mte_ciphers_none and the external hash is used
+  // if the hash algorithm is mte_hashes_none; otherwise they may be nil. The
+  // external states and infos must remain valid while the decoder is in use.
+  public init(_ drbg: mte_drbgs,
+              _ tokBytes: Int,
+              _ verifiers: mte_verifiers,
+              _ cipher: mte_ciphers,
+              _ hash: mte_hashes,
+              _ cipherState: UnsafeMutableRawPointer?,
+              _ cipherInfo: UnsafePointer<mte_cipher_info>?,
+              _ hashState: UnsafeMutableRawPointer?,
+              _ hashInfo: UnsafePointer<mte_hash_info>?,
+              _ tWindow: UInt64,
+              _ sWindow: Int) throws {
+    if (cipher == mte_ciphers_none && cipherInfo == nil) ||
+       (hash == mte_hashes_none && hashInfo == nil) {
+      throw MteError.logicError("MteMkeDec.init: Invalid options.")
+    }
+
+    // Set up the init info.
+    var info = mte_mke_dec_init_info()
+    info.dec_params.t_window = tWindow
+    info.dec_params.s_window = Int32(sWindow)
+    info.dec_params.drbg = drbg
+    info.dec_params.verifiers = verifiers
+    info.dec_params.tok_bytes = tokBytes
+    info.cipher = cipher
+    info.hash = hash
+    info.cipher_state = cipherState
+    info.cipher_info = cipherInfo
+    info.hash_state = hashState
+    info.hash_info = hashInfo
+
+    // Get the decoder size.
+    let bytes = Int(mte_mke_dec_state_bytes(&info))
+    if bytes == 0 {
+      throw MteError.logicError("MteMkeDec.init: Invalid options.")
+    }
+
+    // Allocate the decoder.
+    myDecoder =
+      UnsafeMutableRawPointer.allocate(byteCount: bytes,
+                                       alignment: MemoryLayout<Int64>.alignment)
+
+    // Get the cipher block size.
+    myCiphBlockBytes = cipher == mte_ciphers_none ?
+      Int(cipherInfo!.pointee.block_bytes) :
+      Int(mte_wrap_base_ciphers_block_bytes(cipher))
+    if myCiphBlockBytes == 0 {
+      throw MteError.logicError("MteMkeDec.init: Invalid options.")
+    }
+
+    // Super.
+    try super.init()
+
+    // Initialize the base.
+    super.initBase(drbg, tokBytes, verifiers, cipher, hash)
+
+    // Initialize the decoder state.
+    let status = mte_mke_dec_state_init(myDecoder, &info)
+    if status != mte_status_success {
+      throw MteError.logicError("MteMkeDec.init: Invalid options.")
+    }
+
+    // Allocate the save buffers.
+    mySaveBuff = [UInt8](repeating: 0,
+                         count: Int(mte_wrap_mke_dec_save_bytes(myDecoder)))
+    mySaveBuff64 = [UInt8](repeating: 0,
+                         count: Int(mte_wrap_mke_dec_save_bytes_b64(myDecoder)))
+  }
+
   // Deallocate. The uninstantiate method is called.
   deinit {
     // Uninstantiate.
@@ -343,6 +417,81 @@ public class MteMkeDec : MteBase {
     return (decOff + Int(dOff), Int(dBytes), status)
   }
 
+  // Decode/decrypt each of the given encoded versions in order, exactly as if
+  // decode() were called on each one in turn. An error decoding one does not
+  // stop the rest from being decoded. The decoded versions are packed one
+  // after another in a single buffer. Returns the buffer and, for each encoded
+  // version, the offset and length in bytes of the decoded version in the
+  // buffer, the status, the encode/decode timestamps, and the messages
+  // skipped. The decoded version is valid only if !statusIsError(status);
+  // otherwise its length is 0. An encoded version with no decode buffer
+  // requirement is not decoded and gets mte_status_invalid_input.
+  public func decodeBatch(_ encoded: [[UInt8]]) ->
+  (decoded: ArraySlice<UInt8>, offs: [Int], lens: [Int],
+   statuses: [mte_status], encTs: [UInt64], decTs: [UInt64],
+   msgSkipped: [UInt32]) {
+    // Get the decode buffer requirements.
+    let buffBytes = encoded.map {
+      Int(mte_wrap_mke_dec_buff_bytes(myDecoder, UInt32($0.count)))
+    }
+
+    // Decode.
+    var encTs = [UInt64](repeating: 0, count: encoded.count)
+    var decTs = [UInt64](repeating: 0, count: encoded.count)
+    var msgSkipped = [UInt32](repeating: 0, count: encoded.count)
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    let r = MteBase.packBatch(&myDecBuff, buffBytes, false) { i, buff in
+      var dOff: UInt32 = 0
+      var dBytes: UInt32 = 0
+      let status = mte_wrap_mke_dec_decode(myDecoder,
+                                           MteBase.ourTimestampCallback, uc,
+                                           encoded[i], UInt32(encoded[i].count),
+                                           buff, &dOff, &dBytes,
+                                           &myEncTs, &myDecTs, &myMsgSkipped)
+      encTs[i] = myEncTs
+      decTs[i] = myDecTs
+      msgSkipped[i] = myMsgSkipped
+      return (status, Int(dOff), Int(dBytes))
+    }
+
+    // Return the decoded part and the per-message information.
+    return (myDecBuff[0..<r.end], r.offs, r.lens, r.statuses,
+            encTs, decTs, msgSkipped)
+  }
+  public func decodeBatchB64(_ encoded: [String]) ->
+  (decoded: ArraySlice<UInt8>, offs: [Int], lens: [Int],
+   statuses: [mte_status], encTs: [UInt64], decTs: [UInt64],
+   msgSkipped: [UInt32]) {
+    // Get the decode buffer requirements.
+    let buffBytes = encoded.map {
+      Int(mte_wrap_mke_dec_buff_bytes_b64(myDecoder, UInt32($0.utf8.count)))
+    }
+
+    // Decode.
+    var encTs = [UInt64](repeating: 0, count: encoded.count)
+    var decTs = [UInt64](repeating: 0, count: encoded.count)
+    var msgSkipped = [UInt32](repeating: 0, count: encoded.count)
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    let r = MteBase.packBatch(&myDecBuff, buffBytes, false) { i, buff in
+      var dOff: UInt32 = 0
+      var dBytes: UInt32 = 0
+      let status =
+        mte_wrap_mke_dec_decode_b64(myDecoder,
+                                    MteBase.ourTimestampCallback, uc,
+                                    encoded[i], UInt32(encoded[i].utf8.count),
+                                    buff, &dOff, &dBytes,
+                                    &myEncTs, &myDecTs, &myMsgSkipped)
+      encTs[i] = myEncTs
+      decTs[i] = myDecTs
+      msgSkipped[i] = myMsgSkipped
+      return (status, Int(dOff), Int(dBytes))
+    }
+
+    // Return the decoded part and the per-message information.
+    return (myDecBuff[0..<r.end], r.offs, r.lens, r.statuses,
+            encTs, decTs, msgSkipped)
+  }
+
   // Start a chunk-based decryption session. Returns the status.
   public func startDecrypt() -> mte_status {
     // Resize the decryptor buffer if necessary.
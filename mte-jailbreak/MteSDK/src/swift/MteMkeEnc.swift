@@ -28,6 +28,9 @@ import Mte
 import Core
 #endif
 
+// Imports for parallel encode.
+import Dispatch
+
 // Class MteEnc
 //
 // This is the MTE Managed-Key Encryption encoder/encryptor.
@@ -41,7 +44,7 @@ import Core
 //
 // To use as a chunk-based encryptor, call startEncrypt(), call encryptChunk()
 // zero or more times to encrypt each chunk of data, then finishEncrypt().
-public class MteMkeEnc : MteBase {
+public class MteMkeEnc : MteBase, MteReseedCounter {
   // Initialize using default options.
   public override convenience init() throws {
     try self.init(MteBase.getDefaultDrbg(),
@@ -97,6 +100,68 @@ public class MteMkeEnc : MteBase {
                          count: Int(mte_wrap_mke_enc_save_bytes_b64(myEncoder)))
   }
 
+  // Initialize taking the DRBG, token size in bytes, verifiers algorithm,
+  // cipher algorithm, hash algorithm, and external cipher and hash states and
+  // infos. The external cipher is used if the cipher algorithm is
+  // mte_ciphers_none and the external hash is used if the hash algorithm is
+  // mte_hashes_none; otherwise they may be nil. The external states and infos
+  // must remain valid while the encoder is in use.
+  public init(_ drbg: mte_drbgs,
+              _ tokBytes: Int,
+              _ verifiers: mte_verifiers,
+              _ cipher: mte_ciphers,
+              _ hash: mte_hashes,
+              _ cipherState: UnsafeMutableRawPointer?,
+              _ cipherInfo: UnsafePointer<mte_cipher_info>?,
+              _ hashState: UnsafeMutableRawPointer?,
+              _ hashInfo: UnsafePointer<mte_hash_info>?) throws {
+    if (cipher == mte_ciphers_none && cipherInfo == nil) ||
+       (hash == mte_hashes_none && hashInfo == nil) {
+      throw MteError.logicError("MteMkeEnc.init: Invalid options.")
+    }
+
+    // Set up the init info.
+    var info = mte_mke_enc_init_info()
+    info.enc_params.drbg = drbg
+    info.enc_params.verifiers = verifiers
+    info.enc_params.tok_bytes = tokBytes
+    info.cipher = cipher
+    info.hash = hash
+    info.cipher_state = cipherState
+    info.cipher_info = cipherInfo
+    info.hash_state = hashState
+    info.hash_info = hashInfo
+
+    // Get the encoder size.
+    let bytes = Int(mte_mke_enc_state_bytes(&info))
+    if bytes == 0 {
+      throw MteError.logicError("MteMkeEnc.init: Invalid options.")
+    }
+
+    // Allocate the encoder.
+    myEncoder =
+      UnsafeMutableRawPointer.allocate(byteCount: bytes,
+                                       alignment: MemoryLayout<Int64>.alignment)
+
+    // Super.
+    try super.init()
+
+    // Initialize the base.
+    super.initBase(drbg, tokBytes, verifiers, cipher, hash)
+
+    // Initialize the encoder state.
+    let status = mte_mke_enc_state_init(myEncoder, &info)
+    if status != mte_status_success {
+      throw MteError.logicError("MteMkeEnc.init: Invalid options.")
+    }
+
+    // Allocate the save buffers.
+    mySaveBuff = [UInt8](repeating: 0,
+                         count: Int(mte_wrap_mke_enc_save_bytes(myEncoder)))
+    mySaveBuff64 = [UInt8](repeating: 0,
+                         count: Int(mte_wrap_mke_enc_save_bytes_b64(myEncoder)))
+  }
+
   // Deallocate. The uninstantiate method is called.
   deinit {
     // Uninstantiate.
@@ -189,29 +254,21 @@ public class MteMkeEnc : MteBase {
   }
   public func encodeB64(_ data: [UInt8]) ->
   (encoded: String, status: mte_status) {
-    // Get the encode buffer requirement and resize if necessary.
+    // Get the encode buffer requirement.
     let buffBytes = mte_wrap_mke_enc_buff_bytes_b64(myEncoder,
                                                     UInt32(data.count))
-    MteBase.resizeArray(&myEncBuff, buffBytes)
 
     // Encode.
-    var status = mte_status_success
-    let b64 = myEncBuff.withUnsafeMutableBytes { (buff) -> String in
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    return MteBase.encodeB64String(Int(buffBytes), &myEncBuff) { buff in
       var eOff: UInt32 = 0
       var eBytes: UInt32 = 0
-      let uc = Unmanaged.passUnretained(self).toOpaque()
-      status = mte_wrap_mke_enc_encode_b64(myEncoder,
-                                           MteBase.ourTimestampCallback, uc,
-                                           data, UInt32(data.count),
-                                           buff.baseAddress, &eOff, &eBytes)
-      if status != mte_status_success {
-        return String()
-      }
-      let buffOff = buff.baseAddress!.advanced(by: Int(eOff))
-      let buffOffC = buffOff.assumingMemoryBound(to: CChar.self)
-      return String(cString: buffOffC)
+      let status = mte_wrap_mke_enc_encode_b64(myEncoder,
+                                               MteBase.ourTimestampCallback, uc,
+                                               data, UInt32(data.count),
+                                               buff, &eOff, &eBytes)
+      return (status, Int(eOff), Int(eBytes))
     }
-    return (b64, status)
   }
 
   // Encode/encrypt the given string. Returns the encoded/encrypted version and
@@ -242,29 +299,21 @@ public class MteMkeEnc : MteBase {
   }
   public func encodeB64(_ str: String) ->
   (encoded: String, status: mte_status) {
-    // Get the encode buffer requirement and resize if necessary.
+    // Get the encode buffer requirement.
     let buffBytes = mte_wrap_mke_enc_buff_bytes_b64(myEncoder,
                                                     UInt32(str.utf8.count))
-    MteBase.resizeArray(&myEncBuff, buffBytes)
 
     // Encode.
-    var status = mte_status_success
-    let b64 = myEncBuff.withUnsafeMutableBytes { (buff) -> String in
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    return MteBase.encodeB64String(Int(buffBytes), &myEncBuff) { buff in
       var eOff: UInt32 = 0
       var eBytes: UInt32 = 0
-      let uc = Unmanaged.passUnretained(self).toOpaque()
-      status = mte_wrap_mke_enc_encode_b64(myEncoder,
-                                           MteBase.ourTimestampCallback, uc,
-                                           str, UInt32(str.utf8.count),
-                                           buff.baseAddress, &eOff, &eBytes)
-      if status != mte_status_success {
-        return String()
-      }
-      let buffOff = buff.baseAddress!.advanced(by: Int(eOff))
-      let buffOffC = buffOff.assumingMemoryBound(to: CChar.self)
-      return String(cString: buffOffC)
+      let status = mte_wrap_mke_enc_encode_b64(myEncoder,
+                                               MteBase.ourTimestampCallback, uc,
+                                               str, UInt32(str.utf8.count),
+                                               buff, &eOff, &eBytes)
+      return (status, Int(eOff), Int(eBytes))
     }
-    return (b64, status)
   }
 
   // Encode the given data of the given length at the given offset to the
@@ -316,6 +365,222 @@ public class MteMkeEnc : MteBase {
     return (encOff + Int(eOff), Int(eBytes), status)
   }
 
+  // Encode the given segments joined as one message, exactly as if they were
+  // concatenated and passed to encode(). This is a convenience, not a
+  // zero-copy path: the segments are copied into a buffer kept between calls,
+  // which saves the caller assembling the message but not the copy. Returns
+  // the encoded version and the status.
+  public func encodeJoined(_ segments: [[UInt8]]) ->
+  (encoded: ArraySlice<UInt8>, status: mte_status) {
+    // Join the segments.
+    let dataBytes = MteBase.joinArray(&myJoinBuff, segments)
+
+    // Get the encode buffer requirement and resize if necessary.
+    let buffBytes = mte_wrap_mke_enc_buff_bytes(myEncoder,
+                                                UInt32(dataBytes))
+    MteBase.resizeArray(&myEncBuff, buffBytes)
+
+    // Encode.
+    var eOff: UInt32 = 0
+    var eBytes: UInt32 = 0
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    let status = myEncBuff.withUnsafeMutableBytes { buff in
+      mte_wrap_mke_enc_encode(myEncoder,
+                              MteBase.ourTimestampCallback, uc,
+                              myJoinBuff, UInt32(dataBytes),
+                              buff.baseAddress, &eOff, &eBytes)
+    }
+    if status != mte_status_success {
+      return (ArraySlice<UInt8>(), status)
+    }
+
+    // Return the encoded part.
+    return (myEncBuff[Int(eOff)..<Int(eOff + eBytes)], status)
+  }
+  public func encodeJoinedB64(_ segments: [[UInt8]]) ->
+  (encoded: String, status: mte_status) {
+    // Join the segments.
+    let dataBytes = MteBase.joinArray(&myJoinBuff, segments)
+
+    // Get the encode buffer requirement.
+    let buffBytes = mte_wrap_mke_enc_buff_bytes_b64(myEncoder,
+                                                    UInt32(dataBytes))
+
+    // Encode.
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    return MteBase.encodeB64String(Int(buffBytes), &myEncBuff) { buff in
+      var eOff: UInt32 = 0
+      var eBytes: UInt32 = 0
+      let status = mte_wrap_mke_enc_encode_b64(myEncoder,
+                                               MteBase.ourTimestampCallback, uc,
+                                               myJoinBuff, UInt32(dataBytes),
+                                               buff, &eOff, &eBytes)
+      return (status, Int(eOff), Int(eBytes))
+    }
+  }
+
+  // Encode/encrypt each of the given data in order, exactly as if encode()
+  // were called on each one in turn. The encoded versions are packed one after
+  // another in a single buffer, sized once for the batch from each data's
+  // buffer requirement, so a batch of small messages costs one buffer sizing
+  // and one buffer access. Returns the buffer, the offset and length in bytes
+  // of each encoded version in the buffer, and the status. On error, the
+  // offsets and lengths describe only the data encoded before the error.
+  public func encodeBatch(_ data: [[UInt8]]) ->
+  (encoded: ArraySlice<UInt8>, offs: [Int], lens: [Int], status: mte_status) {
+    // Get the encode buffer requirements.
+    let buffBytes = data.map {
+      Int(mte_wrap_mke_enc_buff_bytes(myEncoder, UInt32($0.count)))
+    }
+
+    // Encode.
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    let r = MteBase.packBatch(&myEncBuff, buffBytes, true) { i, buff in
+      var eOff: UInt32 = 0
+      var eBytes: UInt32 = 0
+      let status = mte_wrap_mke_enc_encode(myEncoder,
+                                           MteBase.ourTimestampCallback, uc,
+                                           data[i], UInt32(data[i].count),
+                                           buff, &eOff, &eBytes)
+      return (status, Int(eOff), Int(eBytes))
+    }
+
+    // Return the encoded part.
+    return (myEncBuff[0..<r.end], r.offs, r.lens,
+            r.statuses.last ?? mte_status_success)
+  }
+  public func encodeBatchB64(_ data: [[UInt8]]) ->
+  (encoded: [String], status: mte_status) {
+    // Get the encode buffer requirements.
+    let buffBytes = data.map {
+      Int(mte_wrap_mke_enc_buff_bytes_b64(myEncoder, UInt32($0.count)))
+    }
+
+    // Encode. Each null terminator is overwritten by the next encoded version.
+    let uc = Unmanaged.passUnretained(self).toOpaque()
+    let r = MteBase.packBatch(&myEncBuff, buffBytes, true) { i, buff in
+      var eOff: UInt32 = 0
+      var eBytes: UInt32 = 0
+      let status =
+        mte_wrap_mke_enc_encode_b64(myEncoder,
+                                    MteBase.ourTimestampCallback, uc,
+                                    data[i], UInt32(data[i].count),
+                                    buff, &eOff, &eBytes)
+      return (status, Int(eOff), Int(eBytes))
+    }
+
+    // Return the encoded versions as strings.
+    let encoded = myEncBuff.withUnsafeBytes { buff in
+      zip(r.offs, r.lens).map { (off, bytes) -> String in
+        String(decoding: UnsafeRawBufferPointer(rebasing:
+                                                  buff[off..<off + bytes]),
+               as: UTF8.self)
+      }
+    }
+    return (encoded, r.statuses.last ?? mte_status_success)
+  }
+
+  // Encode each of the given segments as its own message, exactly as if
+  // encode() were called on each one in turn, but with the encryption done in
+  // parallel on the given worker encoders. The workers must have been created
+  // with the same options as this encoder and must not include it.
+  //
+  // This is a segmented multi-message encoder: the result is one MKE message
+  // per segment, each with its own hash, not the single message that chunked
+  // encryption of the whole data gives. The decoder decodes the messages in
+  // order as usual.
+  //
+  // The state before each message is found first by encoding empty messages,
+  // so the DRBG work of each message is done twice. Each worker then restores
+  // the state for its segments, and its state after each one is checked
+  // against the next. If any check fails, the segments are encoded in turn
+  // instead, doing the DRBG work a third time. This encoder ends in the same
+  // state either way. Returns the encoded versions, true if they were encoded
+  // in parallel or false if in turn, and the status. On error, only the
+  // segments encoded before the error are returned.
+  public func encodeMessagesParallel(_ segments: [[UInt8]],
+                                     _ workers: [MteMkeEnc]) ->
+  (encoded: [[UInt8]], parallel: Bool, status: mte_status) {
+    // Find the state before each message and after the last.
+    guard let first = saveState() else {
+      return ([], false, mte_status_unsupported)
+    }
+    var states = [first]
+    states.reserveCapacity(segments.count + 1)
+    var status = mte_status_success
+    for _ in 0..<segments.count {
+      status = encode([UInt8]()).status
+      if status != mte_status_success {
+        break
+      }
+      guard let state = saveState() else {
+        status = mte_status_unsupported
+        break
+      }
+      states.append(state)
+    }
+
+    // Encode in parallel, each worker taking every Nth segment.
+    var encoded = [[UInt8]](repeating: [], count: segments.count)
+    if status == mte_status_success && !workers.isEmpty {
+      var ok = [Bool](repeating: false, count: workers.count)
+      encoded.withUnsafeMutableBufferPointer { ebuff in
+        ok.withUnsafeMutableBufferPointer { obuff in
+          DispatchQueue.concurrentPerform(iterations: workers.count) { w in
+            obuff[w] = MteMkeEnc.encodeStride(workers[w], w, workers.count,
+                                              segments, states, ebuff)
+          }
+        }
+      }
+      if !ok.contains(false) {
+        return (encoded, true, mte_status_success)
+      }
+    }
+
+    // Encode in turn instead.
+    status = restoreState(first)
+    if status != mte_status_success {
+      return ([], false, status)
+    }
+    encoded.removeAll(keepingCapacity: true)
+    for segment in segments {
+      let r = encode(segment)
+      if r.status != mte_status_success {
+        return (encoded, false, r.status)
+      }
+      encoded.append(Array(r.encoded))
+    }
+    return (encoded, false, mte_status_success)
+  }
+
+  // Encode every stride-th segment from the given start with the given
+  // encoder, restoring the state before each one and checking the state after.
+  // Returns true if all were encoded and checked, false if not.
+  private class func encodeStride(_ enc: MteMkeEnc,
+                                  _ start: Int,
+                                  _ stride: Int,
+                                  _ segments: [[UInt8]],
+                                  _ states: [[UInt8]],
+                                  _ out: UnsafeMutableBufferPointer<[UInt8]>) ->
+  Bool {
+    var i = start
+    while i < segments.count {
+      if enc.restoreState(states[i]) != mte_status_success {
+        return false
+      }
+      let r = enc.encode(segments[i])
+      if r.status != mte_status_success {
+        return false
+      }
+      out[i] = Array(r.encoded)
+      guard let after = enc.saveState(), after == states[i + 1] else {
+        return false
+      }
+      i += stride
+    }
+    return true
+  }
+
   // Returns the length of the result finishEncrypt() will produce. Use this if
   // you need to know that size before you can call it.
   public func encryptFinishBytes() -> Int {
@@ -398,6 +663,9 @@ public class MteMkeEnc : MteBase {
   // Encoder buffer.
   private var myEncBuff = [UInt8]()
 
+  // Buffer the segments are joined in.
+  private var myJoinBuff = [UInt8]()
+
   // State save buffer.
   private var mySaveBuff = [UInt8]()
   private var mySaveBuff64 = [UInt8]()
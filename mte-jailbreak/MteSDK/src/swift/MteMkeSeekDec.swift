@@ -0,0 +1,218 @@
+// The MIT License (MIT)
+//
+// Copyright (c) Eclypses, Inc.
+//
+// All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Imports when creating a Swift Package Manager package.
+#if MTE_SWIFT_PACKAGE_MANAGER
+import Mte
+import Core
+#endif
+
+// Class MteMkeSeekDec
+//
+// This decrypts any range of data that was encoded as a series of MKE
+// messages of a fixed segment size, such as with
+// MteMkeEnc.encodeMessagesParallel(), without decrypting the segments before
+// it.
+//
+// To use, keep the encoded segments one after another in storage, with the
+// index returned by getEncEnds() alongside. Create an MKE decoder with a
+// sequencing verifier and a catch-up sequence window (positive sWindow) of at
+// least the number of segments, instantiate it, and create an object of this
+// type with it. Then call decryptRange() to get any range of the data.
+//
+// The index holds only the end offset of each segment; it has no per-segment
+// digests. Each segment is decoded on its own, which verifies its MKE
+// integrity hash, so a range is verified without hashing the whole data. The
+// number of messages the decoder skipped to reach it is checked too, so a
+// segment moved to another position in the storage is rejected, and so is its
+// decoded length: every segment but the last must be the segment size. The
+// decoder reaches a segment by restoring the nearest earlier checkpoint and
+// catching up, which only advances the DRBG; a checkpoint is kept after each
+// decoded segment.
+//
+// Note: the decoder provided to this object cannot be used outside this object
+// as this object will change its state.
+public class MteMkeSeekDec {
+  // Reader of the encoded storage. It must return the given number of bytes
+  // at the given offset, or nil if it cannot.
+  public typealias Reader = (_ offset: Int, _ bytes: Int) -> [UInt8]?
+
+  // Initialize taking the decoder, in its state before the first segment, the
+  // segment size in bytes, the index from getEncEnds(), the reader, and the
+  // maximum number of checkpoints to keep besides the first.
+  public init(_ dec: MteMkeDec,
+              _ segmentBytes: Int,
+              _ encEnds: [Int],
+              _ reader: @escaping Reader,
+              _ maxCheckpoints: Int = 64) throws {
+    guard segmentBytes > 0, maxCheckpoints >= 0,
+          let base = dec.saveState() else {
+      throw MteError.logicError("MteMkeSeekDec.init: Invalid options.")
+    }
+    myDec = dec
+    mySegmentBytes = segmentBytes
+    myEncEnds = encEnds
+    myReader = reader
+    myMaxCheckpoints = maxCheckpoints
+    myCheckpoints[0] = base
+  }
+
+  // Returns the index to keep alongside the given encoded segments, which is
+  // the end offset of each in the storage.
+  public class func getEncEnds(_ encoded: [[UInt8]]) -> [Int] {
+    var ends = [Int]()
+    ends.reserveCapacity(encoded.count)
+    var end = 0
+    for e in encoded {
+      end += e.count
+      ends.append(end)
+    }
+    return ends
+  }
+
+  // Decrypt the given range of the data. The range is clipped to the end of
+  // the data. Returns the decrypted data and the status. On error, no data is
+  // returned.
+  public func decryptRange(_ offset: Int, _ bytes: Int) ->
+  (data: [UInt8], status: mte_status) {
+    if offset < 0 || bytes < 0 {
+      return ([], mte_status_invalid_input)
+    }
+
+    // Clip the range to the end of the data, which is at most the number of
+    // segments times the segment size.
+    let (total, totalOver) =
+      myEncEnds.count.multipliedReportingOverflow(by: mySegmentBytes)
+    let (sum, sumOver) = offset.addingReportingOverflow(bytes)
+    let limit = totalOver ? Int.max : total
+    let end = sumOver ? limit : min(sum, limit)
+    if offset >= end {
+      return ([], mte_status_success)
+    }
+    var data = [UInt8]()
+    data.reserveCapacity(end - offset)
+    var off = offset
+    while off < end {
+      // Decode the segment holding the offset.
+      let seg = off / mySegmentBytes
+      if seg >= myEncEnds.count {
+        break
+      }
+      let r = decodeSegment(seg)
+      if r.status != mte_status_success {
+        return ([], r.status)
+      }
+
+      // Take the part in the range.
+      let first = off - seg * mySegmentBytes
+      if first >= r.data.count {
+        break
+      }
+      let last = min(r.data.count, end - seg * mySegmentBytes)
+      data.append(contentsOf: r.data[first..<last])
+      off = seg * mySegmentBytes + last
+    }
+    return (data, mte_status_success)
+  }
+
+  // Returns the number of checkpoints currently kept, including the first.
+  public func getCheckpointCount() -> Int {
+    return myCheckpoints.count
+  }
+
+  // Decode the given segment. Returns the decoded data and the status.
+  private func decodeSegment(_ seg: Int) ->
+  (data: [UInt8], status: mte_status) {
+    // Read the segment.
+    let encOff = seg == 0 ? 0 : myEncEnds[seg - 1]
+    guard let encoded = myReader(encOff, myEncEnds[seg] - encOff) else {
+      return ([], mte_status_invalid_input)
+    }
+
+    // Restore the nearest checkpoint at or before it, unless the decoder is
+    // already there.
+    var from = seg
+    if myNext != seg {
+      from = myCheckpoints.keys.filter { $0 <= seg }.max()!
+      let status = myDec.restoreState(myCheckpoints[from]!)
+      if status != mte_status_success {
+        myNext = -1
+        return ([], status)
+      }
+    }
+
+    // Decode, catching up if needed.
+    let r = myDec.decode(encoded)
+    if MteBase.statusIsError(r.status) {
+      myNext = -1
+      return ([], r.status)
+    }
+
+    // The segment must be the one at this position, which is the one the
+    // decoder caught up to from the checkpoint. Otherwise the storage holds a
+    // segment from another position.
+    if Int(myDec.getMsgSkipped()) != seg - from {
+      myNext = -1
+      return ([], mte_status_seq_mismatch)
+    }
+
+    // Every segment but the last must decode to the segment size, and the last
+    // to no more, or the data offsets would not match the segments.
+    if r.decoded.count > mySegmentBytes ||
+       (seg < myEncEnds.count - 1 && r.decoded.count != mySegmentBytes) {
+      myNext = -1
+      return ([], mte_status_invalid_input)
+    }
+    let data = Array(r.decoded)
+
+    // Keep a checkpoint after it, dropping the oldest if there are too many.
+    myNext = seg + 1
+    if myCheckpoints[myNext] == nil && myMaxCheckpoints > 0,
+       let saved = myDec.saveState() {
+      if myOrder.count >= myMaxCheckpoints {
+        myCheckpoints[myOrder.removeFirst()] = nil
+      }
+      myCheckpoints[myNext] = saved
+      myOrder.append(myNext)
+    }
+    return (data, mte_status_success)
+  }
+
+  // The decoder.
+  private let myDec: MteMkeDec
+
+  // The segment size, index and reader.
+  private let mySegmentBytes: Int
+  private let myEncEnds: [Int]
+  private let myReader: Reader
+
+  // Checkpoints by the segment the decoder expects next, and the order they
+  // were added in, not including the first.
+  private let myMaxCheckpoints: Int
+  private var myCheckpoints = [Int: [UInt8]]()
+  private var myOrder = [Int]()
+
+  // The segment the decoder expects next, or -1 if unknown.
+  private var myNext = 0
+}
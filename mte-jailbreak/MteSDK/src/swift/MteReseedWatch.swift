@@ -0,0 +1,193 @@
+// The MIT License (MIT)
+//
+// Copyright (c) Eclypses, Inc.
+//
+// All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Imports when creating a Swift Package Manager package.
+#if MTE_SWIFT_PACKAGE_MANAGER
+import Mte
+#endif
+
+// Imports for the lock.
+import Dispatch
+
+// Class MteReseedWatch
+//
+// This watches the reseed counter of an encoder or decoder and replaces it
+// before its seed life is reached, so encoding and decoding never stall or
+// fail at the seed life boundary.
+//
+// To use, create an object of this type with the instantiated encoder or
+// decoder, a high-water mark below the DRBG's reseed interval (see
+// MteBase.getDrbgsReseedInterval()), and a rekey function. Once the reseed
+// counter reaches the high-water mark, the rekey function is called to start
+// a new pairing, such as a key exchange with the peer, while the current
+// object keeps being used. It must call its completion, from any thread, with
+// the new instantiated object, or nil if it failed, in which case it is
+// retried later. Each pairing has an epoch, counting from 0 for the object
+// given at initialization; the new object's epoch is one more than the
+// current one's.
+//
+// The two sides are used differently, because the encoder decides when to
+// switch and the decoder must follow it:
+// - Encoder side: call getWithEpoch() before each message, use the object it
+//   returns, and send the epoch with the message. The new object is used from
+//   the first call after it is ready.
+// - Decoder side: call get() with the epoch received with each message and use
+//   the object it returns. The switch to the new object happens on the first
+//   message with its epoch, not when the local rekey completes, and the old
+//   object is kept so late messages of the old pairing still decode until the
+//   next switch. A message with any other epoch, or with the new epoch before
+//   the local rekey has completed, gets nil. A message with the new epoch
+//   also starts the local rekey if it has not started, since the peer's
+//   counter can reach the high-water mark first; retry the message once the
+//   rekey has completed.
+//
+// The get functions and the objects they return must be used from one thread
+// at a time. Only the rekey completion may be called from any thread.
+public class MteReseedWatch<T: MteReseedCounter> {
+  // Rekey function. It must call the completion with the new object or nil.
+  public typealias Rekey = (_ completion: @escaping (T?) -> Void) -> Void
+
+  // Initialize taking the encoder or decoder, the high-water mark, and the
+  // rekey function.
+  public init(_ current: T, _ highWater: UInt64, _ rekey: @escaping Rekey) {
+    myCurrent = current
+    myHighWater = highWater
+    myRekey = rekey
+  }
+
+  // Encoder side. Returns the object to use for the next message and its
+  // epoch, switching to the new one if it is ready and starting a rekey if the
+  // high-water mark is reached.
+  public func getWithEpoch() -> (object: T, epoch: UInt64) {
+    // Switch if ready.
+    let (current, epoch) = myLock.sync { () -> (T, UInt64) in
+      if myNext != nil {
+        switchNext()
+      }
+      return (myCurrent, myEpoch)
+    }
+    checkHighWater(current)
+    return (current, epoch)
+  }
+
+  // Decoder side. Returns the object for a message with the given epoch,
+  // switching to the new one on the first message with its epoch, or nil if
+  // there is no object for the epoch. Starts a rekey if the high-water mark is
+  // reached or the message has the new epoch before the new object is ready.
+  public func get(_ epoch: UInt64) -> T? {
+    let (obj, current, early) = myLock.sync { () -> (T?, T, Bool) in
+      if epoch == myEpoch + 1 {
+        if myNext == nil {
+          return (nil, myCurrent, true)
+        }
+        switchNext()
+      }
+      if epoch == myEpoch {
+        return (myCurrent, myCurrent, false)
+      }
+      if epoch &+ 1 == myEpoch {
+        return (myPrev, myCurrent, false)
+      }
+      return (nil, myCurrent, false)
+    }
+    if early {
+      startRekey()
+    } else {
+      checkHighWater(current)
+    }
+    return obj
+  }
+
+  // Returns the epoch of the current object.
+  public func getEpoch() -> UInt64 {
+    return myLock.sync { myEpoch }
+  }
+
+  // Returns true if a rekey is in progress or false if not.
+  public func isPending() -> Bool {
+    return myLock.sync { myPending }
+  }
+
+  // Returns the number of times a new object was switched to.
+  public func getSwitchCount() -> UInt64 {
+    return myLock.sync { mySwitches }
+  }
+
+  // Switch to the new object, keeping the current one as the previous one.
+  // Must be called with the lock held.
+  private func switchNext() {
+    myPrev = myCurrent
+    myCurrent = myNext!
+    myNext = nil
+    myEpoch += 1
+    mySwitches += 1
+  }
+
+  // Start a rekey if the given current object reached the high-water mark.
+  private func checkHighWater(_ current: T) {
+    if current.getReseedCounter() >= myHighWater {
+      startRekey()
+    }
+  }
+
+  // Start a rekey if one is not already in progress or done.
+  private func startRekey() {
+    let start = myLock.sync { () -> Bool in
+      if myPending || myNext != nil {
+        return false
+      }
+      myPending = true
+      return true
+    }
+    if start {
+      myRekey { [weak self] next in
+        guard let watch = self else {
+          return
+        }
+        watch.myLock.sync {
+          watch.myNext = next
+          watch.myPending = false
+        }
+      }
+    }
+  }
+
+  // Options.
+  private let myHighWater: UInt64
+  private let myRekey: Rekey
+
+  // The current object and its epoch, the previous one, the new one when
+  // ready, and the lock for them.
+  private var myCurrent: T
+  private var myEpoch = UInt64(0)
+  private var myPrev: T? = nil
+  private var myNext: T? = nil
+  private let myLock = DispatchQueue(label: "MteReseedWatch")
+
+  // True if a rekey is in progress.
+  private var myPending = false
+
+  // Number of switches.
+  private var mySwitches = UInt64(0)
+}
@@ -0,0 +1,270 @@
+// The MIT License (MIT)
+//
+// Copyright (c) Eclypses, Inc.
+//
+// All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Imports when creating a Swift Package Manager package.
+#if MTE_SWIFT_PACKAGE_MANAGER
+import Mte
+#endif
+
+// Class MteWideDec
+//
+// This is a decoder that accepts messages out of order within a window wider
+// than the async sequence window of MteDec allows.
+//
+// To use, create an MteDec with a sequence window equal to the wide window and
+// a scratch MteDec with the same options but the sequence window returned by
+// getScratchWindow(), set up the entropy and nonce on the first, and create an
+// object of this type with both. Then call instantiate() and decode() as with
+// MteDec.
+//
+// The first decoder runs in catch-up mode (positive sequence window). Its
+// state is kept as a checkpoint at instantiation and then each time it has
+// advanced by at least the checkpoint interval, so in-order messages do not
+// pay for a saved state each. A late message is decoded with one restore of
+// the oldest checkpoint still needed, which is at most the window plus the
+// interval before the window start, into the scratch decoder, whose wider
+// window lets it catch up to any message in the window.
+//
+// The work per message is not constant. A message the decoder rejects costs
+// its own catch-up attempt over the window, then one restore and a catch-up
+// decode by the scratch decoder, which generates the tokens of every message
+// from the checkpoint up to the match, or of its whole window of twice the
+// window plus the interval if there is none. Forged and replayed messages pay
+// all of this: the multi-word bitmap of seen sequence numbers is checked in
+// constant time, but only once the catch-up has found the sequence number. A
+// smaller interval lowers the cost but keeps more checkpoints.
+//
+// Note: the decoders provided to this object cannot be used outside this
+// object as this object will change their states.
+public class MteWideDec {
+  // Initialize taking the decoder, the scratch decoder, the window, which must
+  // be the sequence window the decoder was created with, and the checkpoint
+  // interval in messages. The scratch decoder must have been created with the
+  // sequence window getScratchWindow() returns for the window and interval.
+  public init(_ dec: MteDec,
+              _ scratch: MteDec,
+              _ window: Int,
+              _ interval: Int) throws {
+    if window <= 0 || interval <= 0 {
+      throw MteError.logicError("MteWideDec.init: Invalid options.")
+    }
+    myDec = dec
+    myScratch = scratch
+    myWindow = window
+    myInterval = interval
+    myBitmap = [UInt64](repeating: 0,
+                        count: MteWideDec.getBitmapWords(window))
+  }
+
+  // Initialize taking the decoder, the scratch decoder, and the window, using
+  // the window as the checkpoint interval.
+  public convenience init(_ dec: MteDec,
+                          _ scratch: MteDec,
+                          _ window: Int) throws {
+    try self.init(dec, scratch, window, window)
+  }
+
+  // Returns the sequence window the scratch decoder must be created with for
+  // the given window and checkpoint interval. The oldest checkpoint needed is
+  // less than twice the window plus the interval behind the newest message.
+  public class func getScratchWindow(_ window: Int, _ interval: Int) -> Int {
+    return 2 * window + interval
+  }
+
+  // Returns the maximum memory in bytes used to track the given window with
+  // the given checkpoint interval, given the decoder's saved state size in
+  // bytes. This is the bitmap plus one saved state per checkpoint. The
+  // checkpoints after the oldest needed one are at least the interval apart
+  // and within the window.
+  public class func getWindowBytes(_ window: Int,
+                                   _ interval: Int,
+                                   _ saveBytes: Int) -> Int {
+    return getBitmapWords(window) * MemoryLayout<UInt64>.size +
+      (window / interval + 2) * saveBytes
+  }
+
+  // Instantiate the decoder with the personalization string and reset the
+  // window, keeping the first checkpoint. Returns the status.
+  public func instantiate(_ ps: [UInt8]) -> mte_status {
+    reset()
+    let status = myDec.instantiate(ps)
+    return status == mte_status_success ? checkpoint() : status
+  }
+  public func instantiate(_ ps: String) -> mte_status {
+    reset()
+    let status = myDec.instantiate(ps)
+    return status == mte_status_success ? checkpoint() : status
+  }
+
+  // Decode the given encoded version. Returns the decoded data and status. A
+  // message that was already decoded returns mte_status_seq_async_replay; a
+  // message older than the window returns mte_status_seq_outside_window.
+  public func decode(_ encoded: [UInt8]) ->
+  (decoded: ArraySlice<UInt8>, status: mte_status) {
+    return decodeWide { dec in dec.decode(encoded) }
+  }
+  public func decodeB64(_ encoded: String) ->
+  (decoded: ArraySlice<UInt8>, status: mte_status) {
+    return decodeWide { dec in dec.decodeB64(encoded) }
+  }
+
+  // Returns the sequence number of the most recent decode, counting from 0 at
+  // instantiation.
+  public func getMsgSeq() -> UInt64 {
+    return mySeq
+  }
+
+  // Returns the number of checkpoints currently kept.
+  public func getCheckpointCount() -> Int {
+    return myCheckpoints.count
+  }
+
+  // Uninstantiate the decoders and reset the window. Returns the status.
+  public func uninstantiate() -> mte_status {
+    reset()
+    _ = myScratch.uninstantiate()
+    return myDec.uninstantiate()
+  }
+
+  // Returns the number of bitmap words for the window. The bitmap covers the
+  // window behind the base plus the largest skip ahead of it.
+  private class func getBitmapWords(_ window: Int) -> Int {
+    return (2 * window + 63) / 64 + 1
+  }
+
+  // Reset the window.
+  private func reset() {
+    myBase = 0
+    mySeq = 0
+    myCheckpoints.removeAll()
+    for i in 0..<myBitmap.count {
+      myBitmap[i] = 0
+    }
+  }
+
+  // Keep the decoder's state as a checkpoint at the base. Returns the status.
+  private func checkpoint() -> mte_status {
+    guard let saved = myDec.saveState() else {
+      return mte_status_unsupported
+    }
+    myCheckpoints.append((myBase, saved))
+    return mte_status_success
+  }
+
+  // Helpers to test, set and clear a sequence number in the bitmap.
+  private func isSeen(_ seq: UInt64) -> Bool {
+    let bit = Int(seq % UInt64(myBitmap.count * 64))
+    return myBitmap[bit >> 6] & (UInt64(1) << UInt64(bit & 63)) != 0
+  }
+  private func setSeen(_ seq: UInt64, _ seen: Bool) {
+    let bit = Int(seq % UInt64(myBitmap.count * 64))
+    if seen {
+      myBitmap[bit >> 6] |= UInt64(1) << UInt64(bit & 63)
+    } else {
+      myBitmap[bit >> 6] &= ~(UInt64(1) << UInt64(bit & 63))
+    }
+  }
+
+  // Decode with the given decode call, which is made on the decoder first and
+  // then on the scratch decoder if the message is late.
+  private func decodeWide(_ call: (MteDec) ->
+                          (decoded: ArraySlice<UInt8>, status: mte_status)) ->
+  (decoded: ArraySlice<UInt8>, status: mte_status) {
+    if myCheckpoints.isEmpty {
+      return (ArraySlice<UInt8>(), mte_status_unsupported)
+    }
+
+    // Try the decoder.
+    let r = call(myDec)
+    if !MteBase.statusIsError(r.status) {
+      // Clear the skipped sequence numbers and set this one.
+      mySeq = myBase + UInt64(myDec.getMsgSkipped())
+      var s = myBase
+      while s < mySeq {
+        setSeen(s, false)
+        s += 1
+      }
+      setSeen(mySeq, true)
+      myBase = mySeq + 1
+
+      // Keep a checkpoint once the decoder has advanced by the interval.
+      if myBase - myCheckpoints.last!.base >= UInt64(myInterval) {
+        _ = checkpoint()
+      }
+
+      // Drop the oldest checkpoint while the next one is also at or before
+      // the window start; only the newest such checkpoint is needed.
+      while myCheckpoints.count > 1 &&
+            myCheckpoints[1].base + UInt64(myWindow) <= myBase {
+        myCheckpoints.removeFirst()
+      }
+      return r
+    }
+    if r.status != mte_status_seq_outside_window {
+      return r
+    }
+
+    // Catch up from the oldest checkpoint. Any message in the window is within
+    // the scratch decoder's window of it, so one attempt settles it.
+    if myScratch.restoreState(myCheckpoints[0].saved) != mte_status_success {
+      return r
+    }
+    let rr = call(myScratch)
+    if MteBase.statusIsError(rr.status) {
+      return r
+    }
+
+    // Check the window and bitmap.
+    let seq = myCheckpoints[0].base + UInt64(myScratch.getMsgSkipped())
+    if seq >= myBase || seq + UInt64(myWindow) < myBase {
+      return (ArraySlice<UInt8>(), mte_status_seq_outside_window)
+    }
+    if isSeen(seq) {
+      return (ArraySlice<UInt8>(), mte_status_seq_async_replay)
+    }
+    setSeen(seq, true)
+    mySeq = seq
+    return rr
+  }
+
+  // The decoder and scratch decoder.
+  private let myDec: MteDec
+  private let myScratch: MteDec
+
+  // The window and checkpoint interval.
+  private let myWindow: Int
+  private let myInterval: Int
+
+  // The next sequence number the decoder expects and the sequence number of
+  // the most recent decode.
+  private var myBase = UInt64(0)
+  private var mySeq = UInt64(0)
+
+  // Bitmap of seen sequence numbers, indexed modulo its size in bits.
+  private var myBitmap: [UInt64]
+
+  // Checkpoints, oldest first. Each is the decoder's saved state when it was
+  // expecting the base sequence number.
+  private var myCheckpoints = [(base: UInt64, saved: [UInt8])]()
+}
@@ -11,7 +11,8 @@ enum Settings {
     
     static let appPurposeText = """
 \nThis MTE JailBreak Demo demonstrates implementation of JailBreak Detection. \
-\n\nUI Buttons are provided below to run an encode/decode sequence, both with and without Jailbreak detection enabled.
+\n\nUI Buttons are provided below to run an encode/decode sequence, both with and without Jailbreak detection enabled, \
+and to run known-answer checks of the Swift-only SDK classes.
 """
     
     // These values must be set to the values compiled into the library.
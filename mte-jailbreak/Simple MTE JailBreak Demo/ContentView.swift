@@ -58,6 +58,23 @@ struct ContentView: View {
                     )
                     Spacer()
                 }
+                Spacer()
+                HStack {
+                    Spacer()
+                    Button {
+                        manager.runKnownAnswerChecks()
+                    } label: {
+                        Text("Run Known-Answer Checks")
+                            .bold()
+                            .font(.system(size: 30))
+                            .padding(.all)
+                    }
+                    .overlay(
+                        RoundedRectangle(cornerRadius: 16)
+                            .stroke(Color.accentColor, lineWidth: 2)
+                    )
+                    Spacer()
+                }
             }
         }
         .alert("Tap 'Close App' to quit" , isPresented: $closeApp) {
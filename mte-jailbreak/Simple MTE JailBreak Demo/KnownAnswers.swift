@@ -0,0 +1,127 @@
+//
+// ******************************************************
+// Copyright © 2023 Eclypses Inc. All rights reserved.
+// ******************************************************
+
+import Foundation
+
+// Known-answer checks of the Swift-only SDK classes, run from the demo rather
+// than shipped in the SDK. Each returns mte_status_success if it passed.
+enum KnownAnswers {
+
+    // Checks MteBase64 with the RFC 4648 test vectors, which cover each tail
+    // length, both at once and streamed a byte at a time, and with the 64
+    // characters in order.
+    static func checkBase64() -> mte_status {
+        let vectors: [(String, String)] = [
+            ("", ""), ("f", "Zg=="), ("fo", "Zm8="), ("foo", "Zm9v"),
+            ("foob", "Zm9vYg=="), ("fooba", "Zm9vYmE="), ("foobar", "Zm9vYmFy")
+        ]
+        for (data, base64) in vectors {
+            let bytes = [UInt8](data.utf8)
+            if MteBase64.encode(bytes) != base64 || MteBase64.decode(base64) != bytes {
+                return mte_status_impl_error
+            }
+            if streamBase64(bytes) != base64 {
+                return mte_status_impl_error
+            }
+        }
+        let alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+        let alphabetBytes = fromHex("00108310518720928b30d38f41149351559761969b71d79f8218a39259a7a29aabb2dbafc31cb3d35db7e39ebbf3dfbf")
+        if MteBase64.decode(alphabet) != alphabetBytes || MteBase64.encode(alphabetBytes) != alphabet {
+            return mte_status_impl_error
+        }
+        return mte_status_success
+    }
+
+    // Checks MteDrbgChaCha20 through its DRBG callbacks. The key is derived
+    // from entropy input bytes 0 to 31, nonce bytes 32 to 47 and the
+    // personalization string "MteDrbgChaCha20". The request is 64 bytes longer
+    // than the 64 KiB piece, so its last bytes come after the key is replaced.
+    static func checkDrbgChaCha20() -> mte_status {
+        let drbg = MteDrbgChaCha20()
+        let info = drbg.getDrbgInfo().pointee
+        let state = drbg.getDrbgState()
+        var inst = mte_drbg_inst_info()
+        inst.ei_cb = { (_, eiInfo) -> mte_status in
+            for i in 0..<32 {
+                eiInfo!.pointee.buff![i] = UInt8(i)
+            }
+            eiInfo!.pointee.bytes = 32
+            return mte_status_success
+        }
+        inst.n_cb = { (_, nInfo) in
+            for i in 0..<16 {
+                nInfo!.pointee.buff![i] = UInt8(32 + i)
+            }
+            nInfo!.pointee.bytes = 16
+        }
+        let ps = [UInt8]("MteDrbgChaCha20".utf8)
+        var status = ps.withUnsafeBytes { pbuff -> mte_status in
+            inst.ps = pbuff.baseAddress
+            inst.ps_bytes = .init(pbuff.count)
+            return info.instantiate!(state, &inst)
+        }
+        if status != mte_status_success {
+            return status
+        }
+        var out = [UInt8](repeating: 0, count: 65536 + 64)
+        status = out.withUnsafeMutableBytes { buff in
+            info.generate!(state, .init(buff.count), buff.baseAddress!)
+        }
+        _ = info.uninstantiate!(state)
+        if status != mte_status_success {
+            return status
+        }
+        if Array(out.prefix(32)) != fromHex("ed0041fee5eb3528b01f4214d003d6e4dcb8094ecabfe1322d100c14ee85e3a0") ||
+           Array(out.suffix(32)) != fromHex("ca30f55d03ec621fe0622523081136f568f64872ec7d46ebb5d250abca0bd01e") {
+            return mte_status_drbg_catastrophic
+        }
+        return mte_status_success
+    }
+
+    // Checks MteHashBlake3 with and without parallel hashing, using inputs of
+    // the BLAKE3 test vectors, whose byte i is i % 251. The lengths cover a
+    // partial block, a partial chunk, a full chunk, a partial last chunk, the
+    // 4-chunk SIMD path, and enough full chunks for parallel hashing.
+    static func checkHashBlake3() -> mte_status {
+        let vectors: [(Int, String)] = [
+            (0, "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262"),
+            (1, "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213"),
+            (65, "de1e5fa0be70df6d2be8fffd0e99ceaa8eb6e8c93a63f2d8d1c30ecb6b263dee"),
+            (1024, "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7"),
+            (1025, "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444"),
+            (8193, "bab6c09cb8ce8cf459261398d2e7aef35700bf488116ceb94a36d0f5f1b7bc3b"),
+            (204800, "3eb0463bd7435847ae07cca18e25efd6424172d55d2a071184bab648b9050258")
+        ]
+        let serial = MteHashBlake3(false)
+        let parallel = MteHashBlake3(true)
+        for (bytes, digest) in vectors {
+            let data = (0..<bytes).map { UInt8($0 % 251) }
+            let expected = fromHex(digest)
+            if serial.hash(data) != expected || parallel.hash(data) != expected {
+                return mte_status_hash_test_failed
+            }
+        }
+        return mte_status_success
+    }
+
+    // Encodes with the streaming API, one byte per chunk.
+    private static func streamBase64(_ bytes: [UInt8]) -> String {
+        let codec = MteBase64()
+        var encoded = ""
+        codec.startEncode()
+        for b in bytes {
+            encoded += codec.encodeChunk([b])
+        }
+        return encoded + codec.finishEncode()
+    }
+
+    // Converts hex to bytes.
+    static func fromHex(_ hex: String) -> [UInt8] {
+        let digits = Array(hex.utf8)
+        return stride(from: 0, to: digits.count, by: 2).map { i in
+            UInt8(String(decoding: digits[i..<i + 2], as: UTF8.self), radix: 16)!
+        }
+    }
+}
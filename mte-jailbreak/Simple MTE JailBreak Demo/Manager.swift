@@ -43,6 +43,21 @@ class Manager: ObservableObject {
         compare(plaintext: valueToEncode, decoded: decoded)
     }
     
+    func runKnownAnswerChecks() {
+        message = "Running known-answer checks"
+        report(name: "MteBase64", status: KnownAnswers.checkBase64())
+        report(name: "MteDrbgChaCha20", status: KnownAnswers.checkDrbgChaCha20())
+        report(name: "MteHashBlake3", status: KnownAnswers.checkHashBlake3())
+    }
+    
+    func report(name: String, status: mte_status) {
+        if status == mte_status_success {
+            message = message + "\n\(name): passed."
+        } else {
+            message = message + "\n\(name): FAILED. Status: \(MteBase.getStatusName(status))."
+        }
+    }
+    
     func setInitialValues() {
         // Create the entropy we need. Because it will be zeroized when set by the Encoder or Decoder
         // we will copy it from encoderEntropy to decoderEntropy